@@ -1,9 +1,114 @@
 #include <stdbool.h>
+#include <stdlib.h>
 #include <string.h>
 
 #include "collections/dict.h"
+#include "collections/intern.h"
 #include "xmalloc.h"
 
+static int ptr_cmp(const char *a, const char *b) {
+    return ((uintptr_t)a > (uintptr_t)b) - ((uintptr_t)a < (uintptr_t)b);
+}
+
+static bool keys_search(const struct dict_keys *keys, const char *ikey, size_t *index) {
+    size_t l = 0, r = keys->size;
+
+    while (l < r) {
+        const size_t m = l + (r - l) / 2;
+
+        const int cmp = ptr_cmp(keys->data[m], ikey);
+        if (cmp < 0) {
+            l = m + 1;
+        } else if (cmp > 0) {
+            r = m;
+        } else {
+            *index = m;
+            return true;
+        }
+    }
+
+    *index = l;
+    return false;
+}
+
+static void keys_add_interned(struct dict_keys *keys, const char *ikey) {
+    size_t index;
+    if (keys_search(keys, ikey, &index)) {
+        return;
+    }
+
+    if (keys->size == keys->cap) {
+        keys->cap = keys->cap ? keys->cap * 2 : 8;
+        keys->data = xreallocarray(keys->data, keys->cap, sizeof(keys->data[0]));
+    }
+
+    const char **pos = &keys->data[index];
+    memmove(pos + 1, pos, sizeof(*pos) * (keys->size - index));
+    keys->size += 1;
+
+    *pos = intern_ref(ikey);
+}
+
+static bool keys_has_interned(const struct dict_keys *keys, const char *ikey) {
+    size_t index;
+    return ikey && keys_search(keys, ikey, &index);
+}
+
+void dict_keys_add(struct dict_keys *keys, const char *key) {
+    const char *ikey = intern(key);
+    keys_add_interned(keys, ikey);
+    intern_unref(ikey);
+}
+
+bool dict_keys_has(const struct dict_keys *keys, const char *key) {
+    return keys_has_interned(keys, intern_find(key));
+}
+
+void dict_keys_clear(struct dict_keys *keys) {
+    for (size_t i = 0; i < keys->size; i++) {
+        intern_unref(keys->data[i]);
+    }
+    keys->size = 0;
+}
+
+void dict_keys_free(struct dict_keys *keys) {
+    dict_keys_clear(keys);
+    free(keys->data);
+
+    *keys = (struct dict_keys){0};
+}
+
+struct dict_changes *dict_changes_create(void) {
+    struct dict_changes *changes = xzalloc(sizeof(*changes));
+    changes->refcnt = 1;
+
+    return changes;
+}
+
+struct dict_changes *dict_changes_ref(struct dict_changes *changes) {
+    changes->refcnt += 1;
+
+    return changes;
+}
+
+void dict_changes_unref(struct dict_changes **pchanges) {
+    struct dict_changes *changes = *pchanges;
+
+    if (changes && --changes->refcnt == 0) {
+        dict_keys_free(&changes->keys);
+        free(changes);
+    }
+    *pchanges = NULL;
+}
+
+void dict_changes_clear(struct dict_changes *changes) {
+    dict_keys_clear(&changes->keys);
+}
+
+bool dict_changes_has(const struct dict_changes *changes, const char *key) {
+    return !changes || dict_keys_has(&changes->keys, key);
+}
+
 void dict_reserve(struct dict *dict, size_t cap) {
     if (dict->cap >= cap) {
         return;
@@ -16,95 +121,175 @@ void dict_reserve(struct dict *dict, size_t cap) {
 void dict_clear(struct dict *dict) {
     for (size_t i = 0; i < dict->size; i++) {
         struct dict_item *item = &dict->items[i];
-        free(item->key);
-        free(item->val);
+        intern_unref(item->key);
+        intern_unref(item->val);
     }
 
     dict->size = 0;
 }
 
 void dict_free(struct dict *dict) {
-    for (size_t i = 0; i < dict->size; i++) {
-        struct dict_item *item = &dict->items[i];
-        free(item->key);
-        free(item->val);
-    }
+    dict_clear(dict);
     free(dict->items);
 
     *dict = (struct dict){0};
 }
 
-static bool search(const struct dict *dict, const char *key, size_t *index) {
-    ssize_t l = 0, r = dict->size - 1;
+static int item_cmp(const void *a, const void *b) {
+    const struct dict_item *ia = a, *ib = b;
+    return ptr_cmp(ia->key, ib->key);
+}
 
-    while (l <= r) {
-        const ssize_t m = l + (r - l) / 2;
-        const struct dict_item *item = &dict->items[m];
+/* items of both arrays are sorted by key and have no duplicates */
+static void diff(const struct dict_item *a, size_t na, const struct dict_item *b, size_t nb,
+                 struct dict_keys *changes) {
+    size_t i = 0, j = 0;
+    while (i < na || j < nb) {
+        const int cmp = (i == na) ? 1 : (j == nb) ? -1 : ptr_cmp(a[i].key, b[j].key);
+        if (cmp < 0) {
+            keys_add_interned(changes, a[i++].key);
+        } else if (cmp > 0) {
+            keys_add_interned(changes, b[j++].key);
+        } else {
+            if (a[i].val != b[j].val) {
+                keys_add_interned(changes, a[i].key);
+            }
+            i += 1;
+            j += 1;
+        }
+    }
+}
+
+static bool keep_item(const struct dict_keys *only, const char *key) {
+    /* a key that was never interned can't be in the set */
+    return !only || keys_has_interned(only, intern_find(key));
+}
+
+void dict_assign(struct dict *dict, const struct dict_item_ref *items, size_t n,
+                 const struct dict_keys *only, struct dict_changes *changes) {
+    const size_t n_input = n;
+    struct dict_item *new_items = n ? xcalloc(n, sizeof(new_items[0])) : NULL;
+
+    size_t n_kept = 0;
+    for (size_t i = 0; i < n; i++) {
+        if (keep_item(only, items[i].key)) {
+            new_items[n_kept++] = (struct dict_item){
+                intern(items[i].key), intern(items[i].val),
+            };
+        }
+    }
+    n = n_kept;
+
+    qsort(new_items, n, sizeof(new_items[0]), item_cmp);
+
+    /* Drop duplicate keys. qsort is not stable, so the value to keep is looked up in
+     * the input, but duplicates are rare enough for it not to matter */
+    size_t size = 0;
+    for (size_t i = 0; i < n; i++) {
+        struct dict_item *item = &new_items[i];
+
+        if (size > 0 && new_items[size - 1].key == item->key) {
+            intern_unref(item->key);
+            intern_unref(item->val);
+
+            struct dict_item *kept = &new_items[size - 1];
+            for (size_t j = n_input; j-- > 0; ) {
+                if (intern_find(items[j].key) == kept->key) {
+                    const char *ival = intern(items[j].val);
+                    intern_unref(kept->val);
+                    kept->val = ival;
+                    break;
+                }
+            }
+            continue;
+        }
 
-        const int cmp = strcmp(item->key, key);
+        new_items[size++] = *item;
+    }
+
+    /* previous contents must stay alive until they are compared with the new ones */
+    if (changes) {
+        diff(dict->items, dict->size, new_items, size, &changes->keys);
+    }
+
+    dict_clear(dict);
+    free(dict->items);
+
+    dict->items = new_items;
+    dict->size = size;
+    dict->cap = n_input;
+}
+
+static bool search(const struct dict *dict, const char *ikey, size_t *index) {
+    size_t l = 0, r = dict->size;
+
+    while (l < r) {
+        const size_t m = l + (r - l) / 2;
+
+        const int cmp = ptr_cmp(dict->items[m].key, ikey);
         if (cmp < 0) {
             l = m + 1;
         } else if (cmp > 0) {
-            r = m - 1;
+            r = m;
         } else {
-            if (index) {
-                *index = m;
-            }
+            *index = m;
             return true;
         }
     }
 
-    if (index) {
-        *index = l;
-    }
+    *index = l;
     return false;
 }
 
 void dict_insert(struct dict *dict, const char *key, const char *val) {
-    size_t index;
-    const bool present = search(dict, key, &index);
+    const char *ikey = intern(key);
+    const char *ival = intern(val);
 
-    if (!present) {
+    size_t index;
+    if (!search(dict, ikey, &index)) {
         dict_reserve(dict, dict->size + 1);
 
         struct dict_item *pos = &dict->items[index];
         memmove(pos + 1, pos, sizeof(*pos) * (dict->size - index));
         dict->size += 1;
 
-        pos->key = xstrdup(key);
-        pos->val = xstrdup(val);
+        pos->key = ikey;
+        pos->val = ival;
     } else {
         struct dict_item *item = &dict->items[index];
-        if (strcmp(item->val, val)) {
-            free(item->val);
-            item->val = xstrdup(val);
-        }
+        intern_unref(ikey);
+        intern_unref(item->val);
+        item->val = ival;
     }
 }
 
-const char *dict_get(const struct dict *dict, const char *key) {
+const char *dict_get_interned(const struct dict *dict, const char *ikey) {
     size_t index;
-    if (search(dict, key, &index)) {
+    if (ikey && search(dict, ikey, &index)) {
         return dict->items[index].val;
     }
 
     return NULL;
 }
 
+const char *dict_get(const struct dict *dict, const char *key) {
+    /* a key that was never interned can't be in any dict */
+    return dict_get_interned(dict, intern_find(key));
+}
+
 void dict_remove(struct dict *dict, const char *key) {
-    size_t index;
-    const bool present = search(dict, key, &index);
-    struct dict_item *pos = &dict->items[index];
+    const char *ikey = intern_find(key);
 
-    if (!present) {
+    size_t index;
+    if (!ikey || !search(dict, ikey, &index)) {
         return;
     }
 
-    free(pos->key);
-    free(pos->val);
+    struct dict_item *pos = &dict->items[index];
+    intern_unref(pos->key);
+    intern_unref(pos->val);
 
     memmove(pos, pos + 1, sizeof(*pos) * (dict->size - index - 1));
 
     dict->size -= 1;
 }
-
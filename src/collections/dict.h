@@ -2,21 +2,62 @@
 
 #include <stddef.h>
 #include <stdint.h>
+#include <stdbool.h>
 
+/* both key and val are interned, see collections/intern.h */
 struct dict_item {
-    char *key, *val;
+    const char *key, *val;
 };
 
+/* items are sorted by address of the interned key, so lookups compare pointers only */
 struct dict {
     size_t size, cap;
     struct dict_item *items;
 };
 
+/* borrowed key and value, see dict_assign() */
+struct dict_item_ref {
+    const char *key, *val;
+};
+
+/* Set of keys, held interned and sorted by address like dict items */
+struct dict_keys {
+    size_t size, cap;
+    const char **data;
+};
+
+void dict_keys_add(struct dict_keys *keys, const char *key);
+bool dict_keys_has(const struct dict_keys *keys, const char *key);
+void dict_keys_clear(struct dict_keys *keys);
+void dict_keys_free(struct dict_keys *keys);
+
+/* Keys that were added, removed or got a different value, filled by dict_assign().
+ * Refcounted so that one set can be carried by several queued events */
+struct dict_changes {
+    unsigned refcnt;
+    struct dict_keys keys;
+};
+
+struct dict_changes *dict_changes_create(void);
+struct dict_changes *dict_changes_ref(struct dict_changes *changes);
+void dict_changes_unref(struct dict_changes **pchanges);
+void dict_changes_clear(struct dict_changes *changes);
+/* NULL changes means everything changed, so this returns true */
+bool dict_changes_has(const struct dict_changes *changes, const char *key);
+
 void dict_reserve(struct dict *dict, size_t size);
 void dict_clear(struct dict *dict);
 void dict_free(struct dict *dict);
 
+/* Replaces contents of dict with n items, interned and sorted at once.
+ * If the same key appears several times, the last value wins.
+ * If only is not NULL, items with keys not in it are skipped without being interned.
+ * If changes is not NULL, keys that differ between old and new contents are added to it */
+void dict_assign(struct dict *dict, const struct dict_item_ref *items, size_t n,
+                 const struct dict_keys *only, struct dict_changes *changes);
+
 void dict_insert(struct dict *dict, const char *key, const char *val);
 const char *dict_get(const struct dict *dict, const char *key);
+/* same as dict_get(), but key must be interned, which saves hashing it */
+const char *dict_get_interned(const struct dict *dict, const char *ikey);
 void dict_remove(struct dict *dict, const char *key);
-
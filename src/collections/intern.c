@@ -0,0 +1,160 @@
+#include <stdint.h>
+#include <stdbool.h>
+#include <inttypes.h>
+#include <string.h>
+
+#include "collections/intern.h"
+#include "xmalloc.h"
+#include "macros.h"
+#include "log.h"
+#include "utils.h"
+
+struct interned {
+    uint32_t refcnt;
+    uint32_t hash;
+    char str[];
+};
+
+/* open addressing with linear probing, removal shifts following entries back */
+static struct {
+    struct interned **slots;
+    uint32_t n_slots, n_used;
+    uint64_t n_refs;
+} table;
+
+/* grow when more than 3/4 full, same as collections/map.c */
+#define MAX_LOAD_NUM 3
+#define MAX_LOAD_DEN 4
+
+static struct interned *to_interned(const char *istr) {
+    return CONTAINER_OF(istr, struct interned, str);
+}
+
+/* Returns slot that holds str, or the empty slot where it should be placed */
+static struct interned **find_slot(const char *str, uint32_t hash) {
+    const uint32_t mask = table.n_slots - 1;
+
+    for (uint32_t i = hash & mask; ; i = (i + 1) & mask) {
+        struct interned **slot = &table.slots[i];
+        if (*slot == NULL || ((*slot)->hash == hash && strcmp((*slot)->str, str) == 0)) {
+            return slot;
+        }
+    }
+}
+
+static void resize(void) {
+    const uint32_t old_n_slots = table.n_slots;
+    struct interned **old_slots = table.slots;
+
+    table.n_slots = table.n_slots ? table.n_slots * 2 : 256;
+    table.slots = xcalloc(table.n_slots, sizeof(table.slots[0]));
+
+    const uint32_t mask = table.n_slots - 1;
+    for (uint32_t i = 0; i < old_n_slots; i++) {
+        struct interned *in = old_slots[i];
+        if (in == NULL) {
+            continue;
+        }
+
+        uint32_t j = in->hash & mask;
+        while (table.slots[j] != NULL) {
+            j = (j + 1) & mask;
+        }
+        table.slots[j] = in;
+    }
+
+    free(old_slots);
+}
+
+const char *intern(const char *str) {
+    if (str == NULL) {
+        return NULL;
+    }
+
+    if ((table.n_used + 1) * MAX_LOAD_DEN > table.n_slots * MAX_LOAD_NUM) {
+        resize();
+    }
+
+    const uint32_t hash = str_hash(str);
+    struct interned **slot = find_slot(str, hash);
+    if (*slot == NULL) {
+        const size_t size = strlen(str) + 1;
+
+        struct interned *in = xmalloc(sizeof(*in) + size);
+        in->refcnt = 0;
+        in->hash = hash;
+        memcpy(in->str, str, size);
+
+        *slot = in;
+        table.n_used += 1;
+    }
+
+    (*slot)->refcnt += 1;
+    table.n_refs += 1;
+
+    return (*slot)->str;
+}
+
+const char *intern_ref(const char *istr) {
+    if (istr != NULL) {
+        to_interned(istr)->refcnt += 1;
+        table.n_refs += 1;
+    }
+
+    return istr;
+}
+
+static void remove_slot(uint32_t i) {
+    const uint32_t mask = table.n_slots - 1;
+
+    /* move back every following entry that would be unreachable otherwise */
+    for (uint32_t j = (i + 1) & mask; table.slots[j] != NULL; j = (j + 1) & mask) {
+        const uint32_t home = table.slots[j]->hash & mask;
+        /* entry at j can be moved to i if its home is not in the cyclic range (i, j] */
+        const bool movable = (i <= j) ? (home <= i || home > j) : (home <= i && home > j);
+        if (movable) {
+            table.slots[i] = table.slots[j];
+            i = j;
+        }
+    }
+
+    table.slots[i] = NULL;
+    table.n_used -= 1;
+}
+
+void intern_unref(const char *istr) {
+    if (istr == NULL) {
+        return;
+    }
+
+    struct interned *in = to_interned(istr);
+    ASSERT(in->refcnt > 0);
+
+    table.n_refs -= 1;
+    if (--in->refcnt > 0) {
+        return;
+    }
+
+    const uint32_t mask = table.n_slots - 1;
+    uint32_t i = in->hash & mask;
+    while (table.slots[i] != in) {
+        i = (i + 1) & mask;
+    }
+    remove_slot(i);
+
+    free(in);
+}
+
+const char *intern_find(const char *str) {
+    if (str == NULL || table.n_used == 0) {
+        return NULL;
+    }
+
+    struct interned *in = *find_slot(str, str_hash(str));
+    return in ? in->str : NULL;
+}
+
+void intern_log_stats(void) {
+    DEBUG("intern: %"PRIu32" strings, %"PRIu64" references, %"PRIu32" slots",
+          table.n_used, table.n_refs, table.n_slots);
+}
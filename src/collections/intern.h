@@ -0,0 +1,21 @@
+#pragma once
+
+#include <stddef.h>
+
+/*
+ * Global table of refcounted immutable strings. Interning a string that is equal to an
+ * already interned one returns the same pointer, so interned strings can be compared
+ * with == and copied by taking a reference.
+ */
+
+/* Returns interned copy of str with a new reference, NULL if str is NULL */
+const char *intern(const char *str);
+/* Takes another reference to an interned string, NULL is ok */
+const char *intern_ref(const char *istr);
+void intern_unref(const char *istr);
+
+/* Returns interned copy of str without taking a reference, or NULL if there is none */
+const char *intern_find(const char *str);
+
+/* Logs number of interned strings and references to them */
+void intern_log_stats(void);
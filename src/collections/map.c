@@ -1,126 +1,139 @@
 #include "collections/map.h"
 #include "xmalloc.h"
 
+/* grow when more than 3/4 full, higher load makes lookups in big maps noticeably slower */
+#define MAX_LOAD_NUM 3
+#define MAX_LOAD_DEN 4
+
 static uint32_t get_index(uint32_t key, uint32_t n_buckets) {
     const uint32_t p = __builtin_ctz(n_buckets);
     const uint32_t knuth = 2654435769;
     return (key * knuth) >> (sizeof(key) * 8 - p);
 }
 
+/* Places entry, displacing richer entries (ones closer to their home slot) as needed.
+ * Returns slot where entry with matching key was found, or NULL if entry was inserted */
+static struct map_entry *place(struct map *map, struct map_entry entry) {
+    const uint32_t mask = map->n_buckets - 1;
+
+    entry.psl = 1;
+    for (uint32_t i = get_index(entry.key, map->n_buckets); ; i = (i + 1) & mask) {
+        struct map_entry *slot = &map->entries[i];
+
+        if (slot->psl == 0) {
+            *slot = entry;
+            return NULL;
+        } else if (slot->key == entry.key) {
+            /* only possible for the original entry, displaced ones are already unique */
+            return slot;
+        } else if (slot->psl < entry.psl) {
+            const struct map_entry tmp = *slot;
+            *slot = entry;
+            entry = tmp;
+        }
+
+        entry.psl += 1;
+    }
+}
+
 static void resize(struct map *map) {
     const uint32_t old_n_buckets = map->n_buckets;
-    struct map_entry **old_buckets = map->buckets;
+    struct map_entry *old_entries = map->entries;
 
     map->n_buckets = map->n_buckets ? map->n_buckets * 2 : 32;
-    map->buckets = calloc(map->n_buckets, sizeof(map->buckets[0]));
+    map->entries = xcalloc(map->n_buckets, sizeof(map->entries[0]));
 
     for (uint32_t i = 0; i < old_n_buckets; i++) {
-        struct map_entry *old_entry = old_buckets[i], *old_next;
-        while (old_entry) {
-            old_next = old_entry->next;
+        if (old_entries[i].psl != 0) {
+            place(map, old_entries[i]);
+        }
+    }
 
-            struct map_entry **pentry;
-            const uint32_t idx = get_index(old_entry->key, map->n_buckets);
-            for (pentry = &map->buckets[idx]; *pentry; pentry = &(*pentry)->next);
+    free(old_entries);
+}
+
+static struct map_entry *find(struct map *map, uint32_t key) {
+    if (!map->entries) {
+        return NULL;
+    }
 
-            *pentry = old_entry;
-            old_entry->next = NULL;
+    const uint32_t mask = map->n_buckets - 1;
 
-            old_entry = old_next;
+    uint32_t psl = 1;
+    for (uint32_t i = get_index(key, map->n_buckets); ; i = (i + 1) & mask, psl++) {
+        struct map_entry *slot = &map->entries[i];
+
+        if (slot->key == key && slot->psl != 0) {
+            return slot;
+        } else if (slot->psl < psl) {
+            /* Robin Hood invariant: if key was here, it would have displaced this entry */
+            return NULL;
         }
     }
-
-    free(old_buckets);
 }
 
 void *map_insert(struct map *map, uint32_t key, void *val) {
-    if (!map->buckets || map->n_entries >= map->n_buckets) {
+    if (!map->entries
+        || (uint64_t)(map->n_entries + 1) * MAX_LOAD_DEN > (uint64_t)map->n_buckets * MAX_LOAD_NUM) {
         resize(map);
     }
 
-    struct map_entry **pentry;
-    const uint32_t idx = get_index(key, map->n_buckets);
-    for (pentry = &map->buckets[idx]; *pentry; pentry = &(*pentry)->next) {
-        if ((*pentry)->key == key) {
-            void *old_val = (*pentry)->val;
-            (*pentry)->val = val;
-            return old_val;
-        }
+    struct map_entry *existing = place(map, (struct map_entry){ .key = key, .val = val });
+    if (existing) {
+        void *old_val = existing->val;
+        existing->val = val;
+        return old_val;
     }
 
-    *pentry = xmalloc(sizeof(**pentry));
-    **pentry = (struct map_entry){
-        .key = key,
-        .val = val,
-    };
-
     map->n_entries += 1;
 
     return NULL;
 }
 
 void *map_get(struct map *map, uint32_t key) {
-    if (!map->buckets) {
-        return NULL;
-    }
-
-    const uint32_t idx = get_index(key, map->n_buckets);
-    for (struct map_entry *entry = map->buckets[idx]; entry; entry = entry->next) {
-        if (entry->key == key) {
-            return entry->val;
-        }
-    }
-
-    return NULL;
+    struct map_entry *entry = find(map, key);
+    return entry ? entry->val : NULL;
 }
 
 void *map_remove(struct map *map, uint32_t key) {
-    if (!map->buckets) {
+    struct map_entry *entry = find(map, key);
+    if (!entry) {
         return NULL;
     }
 
-    const uint32_t idx = get_index(key, map->n_buckets);
-    for (struct map_entry **pentry = &map->buckets[idx]; *pentry; pentry = &(*pentry)->next) {
-        if ((*pentry)->key == key) {
-            void *val = (*pentry)->val;
-            struct map_entry *next = (*pentry)->next;
-
-            free(*pentry);
-            *pentry = next;
+    void *val = entry->val;
 
-            map->n_entries -= 1;
-            return val;
+    /* backward shift: pull following displaced entries one slot closer to home */
+    const uint32_t mask = map->n_buckets - 1;
+    uint32_t i = entry - map->entries;
+    for (;;) {
+        const uint32_t next = (i + 1) & mask;
+        if (map->entries[next].psl <= 1) {
+            break;
         }
+
+        map->entries[i] = map->entries[next];
+        map->entries[i].psl -= 1;
+        i = next;
     }
+    map->entries[i] = (struct map_entry){0};
 
-    return NULL;
+    map->n_entries -= 1;
+
+    return val;
 }
 
 void map_free(struct map *map) {
-    for (uint32_t i = 0; i < map->n_buckets; i++) {
-        struct map_entry *entry = map->buckets[i], *next;
-        while (entry) {
-            next = entry->next;
-            free(entry);
-            entry = next;
-        }
-    }
-    free(map->buckets);
+    free(map->entries);
     *map = (struct map){0};
 }
 
 void *map_iter_next(struct map *map, struct map_iter_state *s) {
-    switch (s->state) {
-    case 0:
-    s->state = 1;
-    for (s->i = 0; s->i < map->n_buckets; s->i++) {
-        for (s->entry = map->buckets[s->i]; s->entry; s->entry = s->entry->next) {
-            return s->entry->val;
-    case 1:;
+    for (; s->i < map->n_buckets; s->i++) {
+        if (map->entries[s->i].psl != 0) {
+            return map->entries[s->i++].val;
         }
     }
-    }
 
     return NULL;
 }
-
@@ -2,14 +2,22 @@
 
 #include <stdint.h>
 
+/* psl (probe sequence length) is distance from the entry's home slot plus one,
+ * 0 means the slot is empty */
 struct map_entry {
     uint32_t key;
+    uint32_t psl;
     void *val;
-    struct map_entry *next;
 };
 
+/*
+ * Open addressing hash map with Robin Hood probing. Entries are stored inline in one
+ * array, so inserts don't allocate (except when growing), and removal shifts following
+ * entries back instead of leaving tombstones.
+ * Inserting or removing while iterating with MAP_FOREACH is not allowed.
+ */
 struct map {
-    struct map_entry **buckets;
+    struct map_entry *entries;
     uint32_t n_buckets, n_entries;
 };
 
@@ -20,9 +28,7 @@ void *map_remove(struct map *map, uint32_t key);
 void map_free(struct map *map);
 
 struct map_iter_state {
-    unsigned state;
     uint32_t i;
-    struct map_entry *entry;
 };
 
 void *map_iter_next(struct map *map, struct map_iter_state *s);
@@ -6,19 +6,28 @@
 #include "collections/string.h"
 #include "xmalloc.h"
 
-/* make space for len wide characters and a null terminator */
+/* make space for len characters and a null terminator */
 static void make_space(struct string *s, size_t _len) {
     const size_t len = _len + 1;
-    if (s->cap < len) {
+    if (s->cap == 0 && len <= STRING_INLINE_CAP) {
+        return;
+    } else if (s->cap == 0) {
+        /* spill to the heap */
+        const size_t cap = len < STRING_INLINE_CAP * 2 ? STRING_INLINE_CAP * 2 : len;
+        char *heap = xmalloc(cap * sizeof(heap[0]));
+        memcpy(heap, s->inline_buf, (s->len + 1) * sizeof(heap[0]));
+        s->heap = heap;
+        s->cap = cap;
+    } else if (s->cap < len) {
         s->cap = s->cap * 2 < len ? len : s->cap * 2;
-        s->data = xreallocarray(s->data, s->cap, sizeof(s->data[0]));
+        s->heap = xreallocarray(s->heap, s->cap, sizeof(s->heap[0]));
     }
 }
 
 bool string_appendc(struct string *s, char c) {
     make_space(s, s->len + 1);
-    s->data[s->len++] = c;
-    s->data[s->len] = '\0';
+    string_data(s)[s->len++] = c;
+    string_data(s)[s->len] = '\0';
 
     return true;
 }
@@ -30,18 +39,18 @@ bool string_appendwc(struct string *s, wchar_t c) {
     }
 
     make_space(s, s->len + len);
-    wcrtomb(&s->data[s->len], c, &(mbstate_t){0});
+    wcrtomb(&string_data(s)[s->len], c, &(mbstate_t){0});
     s->len += len;
-    s->data[s->len] = '\0';
+    string_data(s)[s->len] = '\0';
 
     return true;
 }
 
 bool string_appendsn(struct string *s, const char *suff, size_t suff_len) {
     make_space(s, s->len + suff_len);
-    memcpy(&s->data[s->len], suff, suff_len);
+    memcpy(&string_data(s)[s->len], suff, suff_len);
     s->len += suff_len;
-    s->data[s->len] = '\0';
+    string_data(s)[s->len] = '\0';
 
     return true;
 }
@@ -58,9 +67,9 @@ bool string_appendwsn(struct string *s, const wchar_t *suff, size_t suff_len) {
     }
 
     make_space(s, s->len + suff_bytes);
-    wcsnrtombs(&s->data[s->len], &suff, suff_len, suff_bytes, &(mbstate_t){0});
+    wcsnrtombs(&string_data(s)[s->len], &suff, suff_len, suff_bytes, &(mbstate_t){0});
     s->len += suff_bytes;
-    s->data[s->len] = '\0';
+    string_data(s)[s->len] = '\0';
 
     return true;
 }
@@ -69,10 +78,8 @@ bool string_appendwsz(struct string *s, const wchar_t *suff) {
     return string_appendwsn(s, suff, wcslen(suff));
 }
 
-int string_printf(struct string *s, const char *fmt, ...) {
-    va_list args, args_copy;
-    va_start(args, fmt);
-
+int string_vprintf(struct string *s, const char *fmt, va_list args) {
+    va_list args_copy;
     va_copy(args_copy, args);
     const int len = vsnprintf(NULL, 0, fmt, args_copy);
     va_end(args_copy);
@@ -81,9 +88,18 @@ int string_printf(struct string *s, const char *fmt, ...) {
     }
 
     make_space(s, s->len + len);
-    vsnprintf(&s->data[s->len], len + 1, fmt, args);
+    vsnprintf(&string_data(s)[s->len], len + 1, fmt, args);
+    s->len += len;
+
+    return len;
+}
 
+int string_printf(struct string *s, const char *fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    const int len = string_vprintf(s, fmt, args);
     va_end(args);
+
     return len;
 }
 
@@ -93,13 +109,13 @@ void string_init(struct string *s) {
 
 void string_clear(struct string *s) {
     s->len = 0;
-    if (s->data) {
-        s->data[0] = '\0';
-    }
+    string_data(s)[0] = '\0';
 }
 
 void string_free(struct string *s) {
-    free(s->data);
+    if (s->cap) {
+        free(s->heap);
+    }
     string_init(s);
 }
 
@@ -1,14 +1,25 @@
 #include <stddef.h>
+#include <stdarg.h>
 #include <stdbool.h>
 
 #if !defined(STRING_STRUCT_TYPE) || !defined(STRING_ELEMENT_TYPE)
 #error "define STRING_STRUCT_TYPE and STRING_ELEMENT_TYPE"
 #endif
 
+#ifndef STRING_INLINE_CAP
+/* strings shorter than this (in elements) are stored inside the struct, without malloc */
+#define STRING_INLINE_CAP 24
+#endif
+
+/* Zero initialised struct is a valid empty string. There are no pointers into the struct
+ * itself, so it can be copied around with memcpy or realloc like any other */
 struct STRING_STRUCT_TYPE {
-    STRING_ELEMENT_TYPE *data; /* always null terminated */
     size_t len; /* without null terminator */
-    size_t cap; /* with null terminator */
+    size_t cap; /* with null terminator, 0 while stored inline */
+    union {
+        STRING_ELEMENT_TYPE *heap;
+        STRING_ELEMENT_TYPE inline_buf[STRING_INLINE_CAP];
+    };
 };
 
 /* I love the C preprocessor */
@@ -19,6 +30,15 @@ struct STRING_STRUCT_TYPE {
 #define STRING_FUNCTION(ret, name, ...) \
     _STRING_FUNCTION(ret, STRING_STRUCT_TYPE, name, ##__VA_ARGS__)
 
+#define __STRING_DATA_FUNCTION(type, elem) \
+    static inline elem *type##_data(const struct type *s) { \
+        return s->cap ? s->heap : (elem *)s->inline_buf; \
+    }
+#define _STRING_DATA_FUNCTION(type, elem) __STRING_DATA_FUNCTION(type, elem)
+
+/* always null terminated, valid until the string is modified */
+_STRING_DATA_FUNCTION(STRING_STRUCT_TYPE, STRING_ELEMENT_TYPE)
+
 STRING_FUNCTION(bool, appendc, char c);
 STRING_FUNCTION(bool, appendwc, wchar_t wc);
 
@@ -28,6 +48,7 @@ STRING_FUNCTION(bool, appendwsz, const wchar_t *suffix);
 STRING_FUNCTION(bool, appendwsn, const wchar_t *suffix, size_t suffix_len);
 
 STRING_FUNCTION(int, printf, const STRING_ELEMENT_TYPE *fmt, ...);
+STRING_FUNCTION(int, vprintf, const STRING_ELEMENT_TYPE *fmt, va_list args);
 
 STRING_FUNCTION(void, init);
 STRING_FUNCTION(void, clear);
@@ -0,0 +1,161 @@
+#include <stddef.h>
+
+#include "collections/sumtree.h"
+
+static uint32_t next_priority(void) {
+    /* xorshift32, priorities only need to look random */
+    static uint32_t state = 2463534242;
+
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+
+    return state;
+}
+
+static int sum(const struct sumtree_node *node) {
+    return node ? node->sum : 0;
+}
+
+static void update(struct sumtree_node *node) {
+    node->sum = sum(node->left) + node->weight + sum(node->right);
+}
+
+static void replace_child(struct sumtree *tree, struct sumtree_node *parent,
+                          struct sumtree_node *old, struct sumtree_node *new) {
+    if (!parent) {
+        tree->root = new;
+    } else if (parent->left == old) {
+        parent->left = new;
+    } else {
+        parent->right = new;
+    }
+
+    if (new) {
+        new->parent = parent;
+    }
+}
+
+/* moves node one level up, its parent becomes its child */
+static void rotate_up(struct sumtree *tree, struct sumtree_node *node) {
+    struct sumtree_node *parent = node->parent;
+
+    replace_child(tree, parent->parent, parent, node);
+
+    if (parent->left == node) {
+        parent->left = node->right;
+        if (parent->left) {
+            parent->left->parent = parent;
+        }
+        node->right = parent;
+    } else {
+        parent->right = node->left;
+        if (parent->right) {
+            parent->right->parent = parent;
+        }
+        node->left = parent;
+    }
+    parent->parent = node;
+
+    update(parent);
+    update(node);
+}
+
+void sumtree_insert_after(struct sumtree *tree, struct sumtree_node *prev,
+                          struct sumtree_node *node, int weight) {
+    *node = (struct sumtree_node){
+        .priority = next_priority(),
+        .weight = weight,
+        .sum = weight,
+    };
+
+    if (!tree->root) {
+        tree->root = node;
+        return;
+    }
+
+    /* new node goes to the leftmost position of the subtree that follows prev */
+    struct sumtree_node *parent;
+    if (!prev) {
+        for (parent = tree->root; parent->left; parent = parent->left);
+        parent->left = node;
+    } else if (!prev->right) {
+        parent = prev;
+        parent->right = node;
+    } else {
+        for (parent = prev->right; parent->left; parent = parent->left);
+        parent->left = node;
+    }
+    node->parent = parent;
+
+    for (struct sumtree_node *n = parent; n; n = n->parent) {
+        n->sum += weight;
+    }
+
+    while (node->parent && node->parent->priority < node->priority) {
+        rotate_up(tree, node);
+    }
+}
+
+void sumtree_remove(struct sumtree *tree, struct sumtree_node *node) {
+    /* push node down until it has at most one child */
+    while (node->left && node->right) {
+        if (node->left->priority > node->right->priority) {
+            rotate_up(tree, node->left);
+        } else {
+            rotate_up(tree, node->right);
+        }
+    }
+
+    struct sumtree_node *parent = node->parent;
+    replace_child(tree, parent, node, node->left ? node->left : node->right);
+
+    for (struct sumtree_node *n = parent; n; n = n->parent) {
+        n->sum -= node->weight;
+    }
+
+    node->parent = node->left = node->right = NULL;
+}
+
+void sumtree_set_weight(struct sumtree_node *node, int weight) {
+    const int diff = weight - node->weight;
+
+    node->weight = weight;
+    for (struct sumtree_node *n = node; n; n = n->parent) {
+        n->sum += diff;
+    }
+}
+
+int sumtree_offset(const struct sumtree_node *node) {
+    int offset = sum(node->left);
+
+    for (const struct sumtree_node *n = node; n->parent; n = n->parent) {
+        if (n->parent->right == n) {
+            offset += sum(n->parent->left) + n->parent->weight;
+        }
+    }
+
+    return offset;
+}
+
+struct sumtree_node *sumtree_find(const struct sumtree *tree, int offset) {
+    struct sumtree_node *node = tree->root;
+
+    while (node) {
+        const int left = sum(node->left);
+        if (offset < left) {
+            node = node->left;
+        } else if (offset < left + node->weight) {
+            return node;
+        } else {
+            offset -= left + node->weight;
+            node = node->right;
+        }
+    }
+
+    return NULL;
+}
+
+int sumtree_total(const struct sumtree *tree) {
+    return sum(tree->root);
+}
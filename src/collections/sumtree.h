@@ -0,0 +1,36 @@
+#pragma once
+
+#include <stdint.h>
+
+/*
+ * Intrusive sequence of weighted nodes (implicit treap) that keeps prefix sums
+ * of weights. Inserting, removing, changing weight of a node, getting offset
+ * of a node and finding node by offset are all O(log n).
+ */
+
+struct sumtree_node {
+    struct sumtree_node *parent, *left, *right;
+    uint32_t priority;
+    int weight; /* weight of this node */
+    int sum; /* weight of this node and all its descendants */
+};
+
+struct sumtree {
+    struct sumtree_node *root;
+};
+
+/* inserts node right after prev, or at the very beginning if prev is NULL */
+void sumtree_insert_after(struct sumtree *tree, struct sumtree_node *prev,
+                          struct sumtree_node *node, int weight);
+void sumtree_remove(struct sumtree *tree, struct sumtree_node *node);
+
+void sumtree_set_weight(struct sumtree_node *node, int weight);
+
+/* sum of weights of all nodes that come before node */
+int sumtree_offset(const struct sumtree_node *node);
+/* returns node that covers offset, i.e. offset(node) <= offset < offset(node) + weight,
+ * or NULL if offset is past the end of the sequence */
+struct sumtree_node *sumtree_find(const struct sumtree *tree, int offset);
+
+/* sum of weights of all nodes */
+int sumtree_total(const struct sumtree *tree);
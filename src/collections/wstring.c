@@ -5,12 +5,21 @@
 #include "xmalloc.h"
 #include "macros.h"
 
-/* make space for len wide characters and a null terminator */
+/* make space for len characters and a null terminator */
 static void make_space(struct wstring *ws, size_t _len) {
     const size_t len = _len + 1;
-    if (ws->cap < len) {
+    if (ws->cap == 0 && len <= STRING_INLINE_CAP) {
+        return;
+    } else if (ws->cap == 0) {
+        /* spill to the heap */
+        const size_t cap = len < STRING_INLINE_CAP * 2 ? STRING_INLINE_CAP * 2 : len;
+        wchar_t *heap = xmalloc(cap * sizeof(heap[0]));
+        memcpy(heap, ws->inline_buf, (ws->len + 1) * sizeof(heap[0]));
+        ws->heap = heap;
+        ws->cap = cap;
+    } else if (ws->cap < len) {
         ws->cap = ws->cap * 2 < len ? len : ws->cap * 2;
-        ws->data = xreallocarray(ws->data, ws->cap, sizeof(ws->data[0]));
+        ws->heap = xreallocarray(ws->heap, ws->cap, sizeof(ws->heap[0]));
     }
 }
 
@@ -20,8 +29,8 @@ bool wstring_appendc(struct wstring *s, char c) {
 
 bool wstring_appendwc(struct wstring *s, wchar_t c) {
     make_space(s, s->len + 1);
-    s->data[s->len++] = c;
-    s->data[s->len] = '\0';
+    wstring_data(s)[s->len++] = c;
+    wstring_data(s)[s->len] = '\0';
 
     return true;
 }
@@ -34,9 +43,9 @@ bool wstring_appendsn(struct wstring *s, const char *suff, size_t suff_len) {
     }
 
     make_space(s, s->len + suff_wchars);
-    mbsnrtowcs(&s->data[s->len], &suff, suff_len, suff_wchars, &(mbstate_t){0});
+    mbsnrtowcs(&wstring_data(s)[s->len], &suff, suff_len, suff_wchars, &(mbstate_t){0});
     s->len += suff_wchars;
-    s->data[s->len] = L'\0';
+    wstring_data(s)[s->len] = L'\0';
 
     return true;
 }
@@ -47,9 +56,9 @@ bool wstring_appendsz(struct wstring *s, const char *suff) {
 
 bool wstring_appendwsn(struct wstring *s, const wchar_t *suff, size_t suff_len) {
     make_space(s, s->len + suff_len);
-    wmemcpy(&s->data[s->len], suff, suff_len);
+    wmemcpy(&wstring_data(s)[s->len], suff, suff_len);
     s->len += suff_len;
-    s->data[s->len] = L'\0';
+    wstring_data(s)[s->len] = L'\0';
 
     return true;
 }
@@ -58,23 +67,28 @@ bool wstring_appendwsz(struct wstring *s, const wchar_t *suff) {
     return wstring_appendwsn(s, suff, wcslen(suff));
 }
 
-int wstring_printf(struct wstring *ws, const wchar_t *fmt, ...) {
+int wstring_vprintf(struct wstring *ws, const wchar_t *fmt, va_list args) {
     /* fuck this shitty libc API. Surely this is enough :clueless: */
     static wchar_t buf[1024];
 
-    va_list args;
-    va_start(args, fmt);
     const int len = vswprintf(buf, SIZEOF_ARRAY(buf), fmt, args);
-    va_end(args);
-
     if (len < 0) {
         return -1;
     }
 
     make_space(ws, ws->len + len);
-    wmemcpy(&ws->data[ws->len], buf, len);
+    wmemcpy(&wstring_data(ws)[ws->len], buf, len);
     ws->len += len;
-    ws->data[ws->len] = L'\0';
+    wstring_data(ws)[ws->len] = L'\0';
+
+    return len;
+}
+
+int wstring_printf(struct wstring *ws, const wchar_t *fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    const int len = wstring_vprintf(ws, fmt, args);
+    va_end(args);
 
     return len;
 }
@@ -85,13 +99,13 @@ void wstring_init(struct wstring *ws) {
 
 void wstring_clear(struct wstring *ws) {
     ws->len = 0;
-    if (ws->data) {
-        ws->data[0] = L'\0';
-    }
+    wstring_data(ws)[0] = L'\0';
 }
 
 void wstring_free(struct wstring *ws) {
-    free(ws->data);
+    if (ws->cap) {
+        free(ws->heap);
+    }
     wstring_init(ws);
 }
 
@@ -104,6 +104,19 @@ static bool percentage_parser(struct parser_context ctx, void *_out) {
     return true;
 }
 
+static bool uint_parser(struct parser_context ctx, void *_out) {
+    unsigned *out = _out;
+
+    uint32_t val;
+    if (!spa_atou32(ctx.val, &val, 10)) {
+        PARSER_ERROR(ctx, "invalid integer");
+        return false;
+    }
+
+    *out = val;
+    return true;
+}
+
 static bool tab_parser(struct parser_context ctx, void *_out) {
     enum tui_tab_type *out = _out;
 
@@ -267,6 +280,7 @@ static const struct section_handler section_handlers[] = {
             { "bar-empty-char", wchar_parser, &config.bar_empty_char[0] },
             { "node-format", format_parser, &config.node_format },
             { "device-format", format_parser, &config.device_format },
+            { "max-fps", uint_parser, &config.max_fps },
             { 0 }
         }
     },
@@ -23,6 +23,9 @@ struct pipemixer_config {
     wchar_t *routes_separator;
     wchar_t *profiles_separator;
 
+    /* 0 means unlimited */
+    unsigned max_fps;
+
     unsigned tabs_count;
     enum tui_tab_type tabs[TUI_TAB_TYPE_COUNT];
     enum tui_tab_type default_tab;
@@ -2,11 +2,27 @@
 #include <unistd.h>
 #include <stdlib.h>
 #include <stdarg.h>
+#include <inttypes.h>
 
 #include "events.h"
-#include "collections/list.h"
+#include "collections/map.h"
+#include "collections/vec.h"
+#include "histogram.h"
 #include "macros.h"
 #include "xmalloc.h"
+#include "slab.h"
+#include "utils.h"
+#include "log.h"
+
+/* dense array of hooks, released hooks leave NULL holes until it is compacted */
+struct hook_array {
+    struct event_hook **data;
+    size_t size, cap;
+    size_t holes;
+
+    /* only for keyed hooks, see event_emitter_add_keyed_hook() */
+    uint32_t key;
+};
 
 struct event_hook {
     const void *callbacks_table;
@@ -22,12 +38,37 @@ struct event_hook {
     bool released;
     int refcnt;
 
-    struct list link;
+    /* location of hook in emitter, array->data[index] == hook */
+    struct event_emitter *emitter;
+    struct hook_array *array;
+    size_t index;
+};
+
+struct event_id_stats {
+    /* from emit (of the oldest coalesced event) to dispatch, and time spent in dispatcher */
+    struct histogram latency, dispatch;
+};
+
+/* one per emitter type, shared by all emitters of that type */
+struct type_stats {
+    const struct event_emitter_type *type;
+    struct event_id_stats *ids; /* indexed by event id */
 };
 
 struct event_emitter {
     event_dispatcher_t *dispatcher;
-    struct list hooks;
+    struct type_stats *stats;
+    /* hooks that get all unkeyed broadcasts */
+    struct hook_array hooks;
+    /* uint32_t key -> struct hook_array *, hooks that only get broadcasts with their key */
+    struct map keyed_hooks;
+    /* arrays are not compacted while hooks are being called */
+    int dispatching;
+
+    /* seq of last event queued by this emitter, see event_emit_coalescing() */
+    uint64_t last_seq;
+    /* birth_seq of the newest hook */
+    uint64_t newest_hook_seq;
 
     /* emitter is freed when released == true && refcnt == 0 */
     bool released;
@@ -38,8 +79,13 @@ struct event {
     uint64_t id;
     union event_data data;
     uint64_t seq;
+    uint64_t emit_time_ns;
     void (*after)(union event_data);
 
+    /* broadcast only to hooks added with this key, see event_emit_keyed() */
+    bool keyed;
+    uint32_t key;
+
     /* owned references */
     struct event_emitter *emitter;
     struct event_hook *hook;
@@ -56,8 +102,18 @@ static struct {
         struct event *ring;
         size_t size, write, read;
     } queue;
+
+    /* hooks and emitters come and go with every node and device */
+    struct slab_pool hooks_pool, emitters_pool;
+
+    struct events_stats stats;
+    VEC(struct type_stats *) type_stats;
+    /* number of events in queue when dispatch starts */
+    struct histogram queue_depth;
 } g = {
     .efd = -1,
+    .hooks_pool = SLAB_POOL_INIT(struct event_hook, 64),
+    .emitters_pool = SLAB_POOL_INIT(struct event_emitter, 32),
 };
 
 static bool queue_is_empty(const struct event_queue *queue) {
@@ -85,30 +141,113 @@ static void queue_grow(struct event_queue *queue) {
     queue->write = i;
 }
 
+static size_t queue_depth(const struct event_queue *queue) {
+    return queue->size ? (queue->write + queue->size - queue->read) % queue->size : 0;
+}
+
 static struct event *queue_push(struct event_queue *queue) {
     if (queue_is_full(queue)) {
         queue_grow(queue);
+        g.stats.queue_grows += 1;
     }
 
     struct event *event = &queue->ring[queue->write];
     queue->write = (queue->write + 1) % queue->size;
 
+    g.stats.max_queue_depth = MAX(g.stats.max_queue_depth, (uint64_t)queue_depth(queue));
+
     return event;
 }
 
-static struct event *queue_pop(struct event_queue *queue) {
+/* copies event out because handlers might push more events and reuse or reallocate the slot */
+static bool queue_pop(struct event_queue *queue, struct event *event) {
     if (queue_is_empty(queue)) {
-        return NULL;
+        return false;
     }
 
-    struct event *event = &queue->ring[queue->read];
+    *event = queue->ring[queue->read];
     queue->read = (queue->read + 1) % queue->size;
 
-    return event;
+    return true;
+}
+
+/* Returns queued event with given seq or NULL if it was already dispatched.
+ * Relies on queued events having consecutive seqs */
+static struct event *queue_find(struct event_queue *queue, uint64_t seq) {
+    if (queue_is_empty(queue)) {
+        return NULL;
+    }
+
+    const uint64_t head_seq = queue->ring[queue->read].seq;
+    if (seq < head_seq) {
+        return NULL;
+    }
+
+    return &queue->ring[(queue->read + (seq - head_seq)) % queue->size];
+}
+
+static void hook_array_append(struct hook_array *array, struct event_hook *hook) {
+    if (array->size == array->cap) {
+        array->cap = array->cap ? array->cap * 2 : 8;
+        array->data = xreallocarray(array->data, array->cap, sizeof(array->data[0]));
+    }
+
+    hook->array = array;
+    hook->index = array->size;
+    array->data[array->size++] = hook;
+}
+
+/* removes holes, keeping order of hooks */
+static void hook_array_compact(struct hook_array *array) {
+    size_t j = 0;
+    for (size_t i = 0; i < array->size; i++) {
+        struct event_hook *hook = array->data[i];
+        if (hook != NULL) {
+            hook->index = j;
+            array->data[j++] = hook;
+        }
+    }
+
+    array->size = j;
+    array->holes = 0;
+}
+
+static void emitter_maybe_compact(struct event_emitter *emitter, struct hook_array *array) {
+    if (emitter->dispatching > 0 || array->holes * 2 <= array->size) {
+        return;
+    }
+
+    hook_array_compact(array);
+
+    if (array->size == 0 && array != &emitter->hooks) {
+        /* nobody is subscribed to this key anymore */
+        map_remove(&emitter->keyed_hooks, array->key);
+        free(array->data);
+        free(array);
+    }
+}
+
+/* newest hooks are called first, hooks added while iterating are not called */
+static void dispatch_to_array(struct event_emitter *emitter, struct hook_array *array,
+                              const struct event *event) {
+    emitter->dispatching += 1;
+
+    /* array->data might be reallocated by callbacks, so always index it anew */
+    for (size_t i = array->size; i-- > 0; ) {
+        struct event_hook *hook = array->data[i];
+        if (hook != NULL && hook->birth_seq < event->seq) {
+            emitter->dispatcher(event->id, event->data,
+                                hook->callbacks_table, hook->callbacks_data,
+                                hook->private_data);
+        }
+    }
+
+    emitter->dispatching -= 1;
+    emitter_maybe_compact(emitter, array);
 }
 
 static void hook_free(struct event_hook *hook) {
-    free(hook);
+    slab_free(&g.hooks_pool, hook);
 }
 
 static void hook_unref(struct event_hook *hook) {
@@ -123,7 +262,15 @@ static struct event_hook *hook_ref(struct event_hook *hook) {
 }
 
 static void emitter_free(struct event_emitter *emitter) {
-    free(emitter);
+    struct hook_array *array;
+    MAP_FOREACH(&emitter->keyed_hooks, &array) {
+        free(array->data);
+        free(array);
+    }
+    map_free(&emitter->keyed_hooks);
+    free(emitter->hooks.data);
+
+    slab_free(&g.emitters_pool, emitter);
 }
 
 static void emitter_unref(struct event_emitter *emitter) {
@@ -137,28 +284,59 @@ static struct event_emitter *emitter_ref(struct event_emitter *emitter) {
     return emitter;
 }
 
-int events_global_init(void) {
-    g.efd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
-    return g.efd;
+int events_global_init(enum events_dispatch_mode mode) {
+    switch (mode) {
+    case EVENTS_DISPATCH_LOOP_HOOK:
+        return 0;
+    case EVENTS_DISPATCH_EVENTFD:
+        g.efd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        return g.efd;
+    }
+
+    return -1;
+}
+
+static void record_dispatch(const struct event *event, uint64_t start_ns, uint64_t end_ns) {
+    const struct type_stats *stats = event->emitter->stats;
+    if (event->id >= stats->type->n_events) {
+        return;
+    }
+
+    struct event_id_stats *id_stats = &stats->ids[event->id];
+    histogram_record(&id_stats->latency, start_ns - event->emit_time_ns);
+    histogram_record(&id_stats->dispatch, end_ns - start_ns);
 }
 
 void events_dispatch(void) {
-    eventfd_read(g.efd, &(uint64_t){});
-    g.efd_triggered = false;
+    if (g.efd_triggered) {
+        eventfd_read(g.efd, &(uint64_t){});
+        g.efd_triggered = false;
+        g.stats.eventfd_syscalls += 1;
+    }
 
-    struct event *event;
-    while ((event = queue_pop(&g.queue))) {
+    const size_t depth = queue_depth(&g.queue);
+    if (depth == 0) {
+        return;
+    }
+    histogram_record(&g.queue_depth, depth);
+
+    /* end of one event is the start of the next one, saves a clock read per event */
+    uint64_t start_ns = monotonic_time_ns();
+
+    struct event ev, *event = &ev;
+    while (queue_pop(&g.queue, event)) {
         struct event_emitter *emitter = event->emitter;
 
-        if (!event->hook) {
+        g.stats.dispatched += 1;
+
+        if (!event->hook && !event->keyed) {
             /* broadcast */
-            LIST_FOREACH(elem, &emitter->hooks) {
-                struct event_hook *hook = CONTAINER_OF(elem, struct event_hook, link);
-                if (!hook->released && hook->birth_seq < event->seq) {
-                    emitter->dispatcher(event->id, event->data,
-                                        hook->callbacks_table, hook->callbacks_data,
-                                        hook->private_data);
-                }
+            dispatch_to_array(emitter, &emitter->hooks, event);
+        } else if (!event->hook) {
+            /* keyed broadcast */
+            struct hook_array *array = map_get(&emitter->keyed_hooks, event->key);
+            if (array != NULL) {
+                dispatch_to_array(emitter, array, event);
             }
         } else {
             /* unicast */
@@ -171,6 +349,10 @@ void events_dispatch(void) {
             hook_unref(hook);
         }
 
+        const uint64_t end_ns = monotonic_time_ns();
+        record_dispatch(event, start_ns, end_ns);
+        start_ns = end_ns;
+
         if (event->after) {
             event->after(event->data);
         }
@@ -179,11 +361,26 @@ void events_dispatch(void) {
     }
 }
 
-struct event_emitter *event_emitter_create(event_dispatcher_t *dispatcher) {
-    struct event_emitter *emitter = xmalloc(sizeof(*emitter));
+static struct type_stats *get_type_stats(const struct event_emitter_type *type) {
+    VEC_FOREACH(&g.type_stats, i) {
+        if (g.type_stats.data[i]->type == type) {
+            return g.type_stats.data[i];
+        }
+    }
+
+    struct type_stats *stats = xmalloc(sizeof(*stats));
+    stats->type = type;
+    stats->ids = xcalloc(type->n_events, sizeof(stats->ids[0]));
+    *VEC_APPEND(&g.type_stats) = stats;
+
+    return stats;
+}
+
+struct event_emitter *event_emitter_create(const struct event_emitter_type *type) {
+    struct event_emitter *emitter = slab_alloc(&g.emitters_pool);
     *emitter = (struct event_emitter){
-        .dispatcher = dispatcher,
-        .hooks = { &emitter->hooks, &emitter->hooks },
+        .dispatcher = type->dispatcher,
+        .stats = get_type_stats(type),
     };
 
     return emitter;
@@ -200,20 +397,47 @@ void event_emitter_release(struct event_emitter *emitter) {
     }
 }
 
-struct event_hook *event_emitter_add_hook(struct event_emitter *emitter,
-                                          const void *callbacks_table, void *callbacks_data,
-                                          void (*remove)(void *private_data), void *private_data) {
-    struct event_hook *hook = xmalloc(sizeof(*hook));
+static struct event_hook *hook_create(struct event_emitter *emitter,
+                                      const void *callbacks_table, void *callbacks_data,
+                                      void (*remove)(void *private_data), void *private_data) {
+    struct event_hook *hook = slab_alloc(&g.hooks_pool);
     *hook = (struct event_hook){
         .callbacks_table = callbacks_table,
         .callbacks_data = callbacks_data,
         .remove = remove,
         .private_data = private_data,
         .birth_seq = g.seq,
+        .emitter = emitter,
     };
+    emitter->newest_hook_seq = g.seq;
+
+    return hook;
+}
 
-    /* prepend to emitter's hook list */
-    list_insert_after(&emitter->hooks, &hook->link);
+struct event_hook *event_emitter_add_hook(struct event_emitter *emitter,
+                                          const void *callbacks_table, void *callbacks_data,
+                                          void (*remove)(void *private_data), void *private_data) {
+    struct event_hook *hook = hook_create(emitter, callbacks_table, callbacks_data,
+                                          remove, private_data);
+    hook_array_append(&emitter->hooks, hook);
+
+    return hook;
+}
+
+struct event_hook *event_emitter_add_keyed_hook(struct event_emitter *emitter, uint32_t key,
+                                                const void *callbacks_table, void *callbacks_data,
+                                                void (*remove)(void *private_data),
+                                                void *private_data) {
+    struct event_hook *hook = hook_create(emitter, callbacks_table, callbacks_data,
+                                          remove, private_data);
+
+    struct hook_array *array = map_get(&emitter->keyed_hooks, key);
+    if (array == NULL) {
+        array = xzalloc(sizeof(*array));
+        array->key = key;
+        map_insert(&emitter->keyed_hooks, key, array);
+    }
+    hook_array_append(array, hook);
 
     return hook;
 }
@@ -223,8 +447,10 @@ void event_hook_release(struct event_hook *hook) {
         return;
     }
 
-    /* remove from emitter's hook list */
-    list_remove(&hook->link);
+    /* remove from emitter's hook array */
+    hook->array->data[hook->index] = NULL;
+    hook->array->holes += 1;
+    emitter_maybe_compact(hook->emitter, hook->array);
 
     /* since no events will be delivered for this hook anymore, it's safe to
      * call remove right now and not wait for hook to actually be destroyed */
@@ -239,40 +465,143 @@ void event_hook_release(struct event_hook *hook) {
 }
 
 static void event_emit_internal(struct event_emitter *emitter, struct event_hook *hook,
+                                bool keyed, uint32_t key,
                                 uint64_t id, void (*after)(union event_data data),
-                                union event_data data) {
+                                union event_data data, bool coalesce) {
+    g.stats.emitted += 1;
+
+    if (coalesce) {
+        /* Only the very last event of this emitter can be replaced, so that events
+         * of one emitter are never reordered. Hooks added after it was queued would
+         * not see it, so it can't be replaced in that case either */
+        struct event *last = queue_find(&g.queue, emitter->last_seq);
+        if (last != NULL && last->emitter == emitter && last->id == id && last->hook == hook
+            && last->keyed == keyed && last->key == key
+            && emitter->newest_hook_seq < last->seq) {
+            if (last->after) {
+                last->after(last->data);
+            }
+            last->data = data;
+            last->after = after;
+
+            g.stats.coalesced += 1;
+            return;
+        }
+    }
+
     struct event *event = queue_push(&g.queue);
     *event = (struct event) {
         .id = id,
         .data = data,
         .seq = ++g.seq,
+        .emit_time_ns = monotonic_time_ns(),
         .after = after,
+        .keyed = keyed,
+        .key = key,
         .emitter = emitter_ref(emitter),
         .hook = hook ? hook_ref(hook) : NULL,
     };
+    emitter->last_seq = event->seq;
 
-    if (!g.efd_triggered) {
+    if (g.efd >= 0 && !g.efd_triggered) {
         eventfd_write(g.efd, 1);
         g.efd_triggered = true;
+        g.stats.eventfd_syscalls += 1;
     }
 }
 
+#define EVENT_DATA_FROM_VA_ARGS(data, type) \
+    do { \
+        va_list ap; \
+        va_start(ap, type); \
+        switch (type) { \
+        case 'p': data.p = va_arg(ap, void *); break; \
+        case 'u': data.u = va_arg(ap, uint64_t); break; \
+        case 'i': data.i = va_arg(ap, int64_t); break; \
+        case 'd': data.d = va_arg(ap, double); break; \
+        case 'b': data.b = va_arg(ap, int); break; \
+        default:  data.u = 0; break; \
+        } \
+        va_end(ap); \
+    } while (0)
+
 void event_emit(struct event_emitter *emitter, struct event_hook *hook,
                 uint64_t id, void (*after)(union event_data data), int type, ...) {
     union event_data data;
+    EVENT_DATA_FROM_VA_ARGS(data, type);
 
-    va_list ap;
-    va_start(ap, type);
-    switch (type) {
-    case 'p': data.p = va_arg(ap, void *); break;
-    case 'u': data.u = va_arg(ap, uint64_t); break;
-    case 'i': data.i = va_arg(ap, int64_t); break;
-    case 'd': data.d = va_arg(ap, double); break;
-    case 'b': data.b = va_arg(ap, int); break;
-    default:  data.u = 0; break;
-    }
-    va_end(ap);
+    event_emit_internal(emitter, hook, false, 0, id, after, data, false);
+}
 
-    event_emit_internal(emitter, hook, id, after, data);
+void event_emit_keyed(struct event_emitter *emitter, uint32_t key,
+                      uint64_t id, void (*after)(union event_data data), int type, ...) {
+    union event_data data;
+    EVENT_DATA_FROM_VA_ARGS(data, type);
+
+    event_emit_internal(emitter, NULL, true, key, id, after, data, false);
+}
+
+void event_emit_coalescing(struct event_emitter *emitter, struct event_hook *hook,
+                           uint64_t id, void (*after)(union event_data data), int type, ...) {
+    union event_data data;
+    EVENT_DATA_FROM_VA_ARGS(data, type);
+
+    event_emit_internal(emitter, hook, false, 0, id, after, data, true);
+}
+
+const struct events_stats *events_get_stats(void) {
+    return &g.stats;
+}
+
+static void log_pool_stats(const struct slab_pool *pool) {
+    DEBUG("events: pool %s: %zu in use, %zu at most, %zu allocated",
+          pool->name, pool->in_use, pool->high_water, pool->capacity);
+}
+
+static double ns_to_us(uint64_t ns) {
+    return ns / 1000.0;
+}
+
+static void log_time_histogram(const char *type, const char *event, const char *what,
+                               const struct histogram *hist) {
+    DEBUG("events: %s.%s %s: p50 %.1fus, p90 %.1fus, p99 %.1fus, max %.1fus, avg %.1fus",
+          type, event, what,
+          ns_to_us(histogram_percentile(hist, 50)),
+          ns_to_us(histogram_percentile(hist, 90)),
+          ns_to_us(histogram_percentile(hist, 99)),
+          ns_to_us(hist->max),
+          ns_to_us(hist->sum / hist->count));
+}
+
+void events_log_stats(void) {
+    DEBUG("events: %"PRIu64" emitted, %"PRIu64" coalesced, %"PRIu64" dispatched, "
+          "%"PRIu64" eventfd syscalls",
+          g.stats.emitted, g.stats.coalesced, g.stats.dispatched, g.stats.eventfd_syscalls);
+    log_pool_stats(&g.hooks_pool);
+    log_pool_stats(&g.emitters_pool);
+
+    DEBUG("events: queue: %zu slots, grown %"PRIu64" times, depth at dispatch "
+          "p50 %"PRIu64", p99 %"PRIu64", max %"PRIu64,
+          g.queue.size, g.stats.queue_grows,
+          histogram_percentile(&g.queue_depth, 50), histogram_percentile(&g.queue_depth, 99),
+          g.stats.max_queue_depth);
+
+    VEC_FOREACH(&g.type_stats, i) {
+        const struct type_stats *stats = g.type_stats.data[i];
+        const struct event_emitter_type *type = stats->type;
+
+        for (unsigned id = 0; id < type->n_events; id++) {
+            const struct event_id_stats *id_stats = &stats->ids[id];
+            if (id_stats->latency.count == 0) {
+                continue;
+            }
+
+            const char *name = type->event_names[id] ?: "?";
+            DEBUG("events: %s.%s: %"PRIu64" dispatched",
+                  type->name, name, id_stats->latency.count);
+            log_time_histogram(type->name, name, "in queue", &id_stats->latency);
+            log_time_histogram(type->name, name, "in dispatcher", &id_stats->dispatch);
+        }
+    }
 }
 
@@ -14,21 +14,58 @@ union event_data {
     bool b;
 };
 
-int events_global_init(void);
+enum events_dispatch_mode {
+    /* events_dispatch() is called by the event loop every time before it goes to sleep */
+    EVENTS_DISPATCH_LOOP_HOOK,
+    /* emitting an event wakes up the event loop through an eventfd, which then
+     * calls events_dispatch(). Costs two syscalls per batch of events */
+    EVENTS_DISPATCH_EVENTFD,
+};
+
+/* returns eventfd to poll for EVENTS_DISPATCH_EVENTFD, otherwise 0, or -1 on error */
+int events_global_init(enum events_dispatch_mode mode);
 void events_dispatch(void);
 
+struct events_stats {
+    uint64_t emitted;
+    uint64_t coalesced; /* merged into an already queued event, see event_emit_coalescing() */
+    uint64_t dispatched;
+    uint64_t eventfd_syscalls; /* only in EVENTS_DISPATCH_EVENTFD mode */
+    uint64_t queue_grows; /* times the event ring had to be reallocated */
+    uint64_t max_queue_depth;
+};
+const struct events_stats *events_get_stats(void);
+/* Logs events_stats, occupancy of hook and emitter pools, histograms of queue depth
+ * and, for every emitter type and event id, of time spent in queue and in dispatcher */
+void events_log_stats(void);
+
 typedef void event_dispatcher_t(uint64_t id, union event_data data,
                                 const void *callbacks, void *callbacks_data,
                                 void *private);
 
 #define EVENT_DISPATCH(fn, ...) if (fn) fn(__VA_ARGS__);
 
-struct event_emitter *event_emitter_create(event_dispatcher_t *dispatcher);
+/* Shared by all emitters of one kind (node, device...), must outlive them */
+struct event_emitter_type {
+    const char *name;
+    event_dispatcher_t *dispatcher;
+    /* indexed by event id, only used for stats */
+    const char *const *event_names;
+    unsigned n_events;
+};
+
+struct event_emitter *event_emitter_create(const struct event_emitter_type *type);
 void event_emitter_release(struct event_emitter *emitter);
 
 struct event_hook *event_emitter_add_hook(struct event_emitter *emitter,
                                           const void *callbacks, void *callbacks_data,
                                           void (*remove)(void *private_data), void *private_data);
+/* Keyed hooks only get events emitted with event_emit_keyed() with the same key
+ * (and unicasts), not regular broadcasts */
+struct event_hook *event_emitter_add_keyed_hook(struct event_emitter *emitter, uint32_t key,
+                                                const void *callbacks, void *callbacks_data,
+                                                void (*remove)(void *private_data),
+                                                void *private_data);
 void event_hook_release(struct event_hook *hook);
 
 /* type of one of p, u, i, d, b, or 0 for empty data */
@@ -36,3 +73,16 @@ void event_emit(struct event_emitter *emitter, struct event_hook *hook,
                 uint64_t id, void (*after)(union event_data data),
                 int type, ...);
 
+/* broadcast to hooks added with event_emitter_add_keyed_hook() with given key */
+void event_emit_keyed(struct event_emitter *emitter, uint32_t key,
+                      uint64_t id, void (*after)(union event_data data),
+                      int type, ...);
+
+/* Same as event_emit(), but if the last event queued by emitter has the same id and hook
+ * and hasn't been dispatched yet, it is replaced with this one instead of queueing a new one
+ * (the replaced event's after callback is called right away).
+ * Only suitable for events that mean "state changed", where only the latest one matters */
+void event_emit_coalescing(struct event_emitter *emitter, struct event_hook *hook,
+                           uint64_t id, void (*after)(union event_data data),
+                           int type, ...);
+
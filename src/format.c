@@ -2,12 +2,16 @@
 #include <setjmp.h>
 #include <stdbool.h>
 #include <string.h>
+#include <wchar.h>
 #include <wctype.h>
 #include <stdio.h>
 
 #include "format.h"
 #include "collections/string.h"
+#include "collections/wstring.h"
+#include "collections/intern.h"
 #include "xmalloc.h"
+#include "log.h"
 
 /*
  * Grammar:
@@ -43,18 +47,46 @@ struct format_node {
             struct wstring str;
         } literal;
         struct format_node_subst {
-            struct string key;
+            const char *key; /* interned */
             enum format_node_subst_type type;
-            struct format *if_true, *if_false;
+            struct format_tree *if_true, *if_false;
         } subst;
     } as;
 };
 
-struct format {
+struct format_tree {
     unsigned nodes_count;
     struct format_node *nodes[];
 };
 
+/*
+ * Parsed tree is compiled into a flat program. Every distinct key gets a slot, values of
+ * slots are looked up once per update by format_args_update(), so rendering is a single
+ * pass over ops with no lookups.
+ */
+enum format_op_type {
+    FORMAT_OP_LITERAL, /* append b bytes of literals starting at byte a */
+    FORMAT_OP_VALUE, /* append value of slot a */
+    FORMAT_OP_JUMP, /* continue at op b */
+    FORMAT_OP_JUMP_IF_ABSENT, /* continue at op b if slot a has no value */
+    FORMAT_OP_JUMP_IF_PRESENT, /* continue at op b if slot a has a value */
+};
+
+struct format_op {
+    enum format_op_type type;
+    unsigned a, b;
+};
+
+struct format {
+    unsigned n_ops;
+    struct format_op *ops;
+
+    unsigned n_slots;
+    const char **keys; /* interned, indexed by slot */
+
+    struct string literals; /* UTF-8 */
+};
+
 struct parser {
     const char *src;
     size_t pos, len;
@@ -65,6 +97,9 @@ struct parser {
     bool has_wchar;
     mbstate_t mbstate;
 
+    /* key being parsed, reused for every key */
+    struct string key;
+
     char *error;
     jmp_buf jmp_buf;
 };
@@ -74,7 +109,8 @@ struct parser {
     longjmp((pp)->jmp_buf, 67); \
 } while (0)
 
-static void parse_format(struct parser *p, struct format **out);
+static void parse_format(struct parser *p, struct format_tree **out);
+static void format_tree_free(struct format_tree *tree);
 
 static bool eof(struct parser *p) {
     return p->pos >= p->len && !p->has_wchar;
@@ -132,18 +168,23 @@ static void expect(struct parser *p, wchar_t expected) {
     }
 }
 
-static void parse_key(struct parser *p, struct string *out) {
+static void parse_key(struct parser *p, const char **out) {
+    struct string *key = &p->key;
+    string_clear(key);
+
     while (!eof(p)) {
         wchar_t c = peek(p);
         if ((c < L'a' || c > L'z') && c != L'.') {
             break;
         }
-        string_appendwc(out, consume(p));
+        string_appendwc(key, consume(p));
     }
 
-    if (!out->len) {
+    if (!key->len) {
         PARSER_ERROR(p, "expected key, got %s", format_wchar(peek(p)));
     }
+
+    *out = intern(string_data(key));
 }
 
 static void parse_subst(struct parser *p, struct format_node **out) {
@@ -217,8 +258,8 @@ static void parse_node(struct parser *p, struct format_node **out) {
     }
 }
 
-static void parse_format(struct parser *p, struct format **out) {
-    struct format *f = *out = xzalloc(sizeof(*f));
+static void parse_format(struct parser *p, struct format_tree **out) {
+    struct format_tree *f = *out = xzalloc(sizeof(*f));
 
     while (!eof(p)) {
         wchar_t c = peek(p);
@@ -235,87 +276,220 @@ static void parse_format(struct parser *p, struct format **out) {
     }
 }
 
+static unsigned emit_op(struct format *fmt, enum format_op_type type, unsigned a, unsigned b) {
+    fmt->ops = xreallocarray(fmt->ops, fmt->n_ops + 1, sizeof(fmt->ops[0]));
+    fmt->ops[fmt->n_ops] = (struct format_op){ .type = type, .a = a, .b = b };
+
+    return fmt->n_ops++;
+}
+
+static unsigned get_slot(struct format *fmt, const char *ikey) {
+    for (unsigned i = 0; i < fmt->n_slots; i++) {
+        if (fmt->keys[i] == ikey) {
+            return i;
+        }
+    }
+
+    fmt->keys = xreallocarray(fmt->keys, fmt->n_slots + 1, sizeof(fmt->keys[0]));
+    fmt->keys[fmt->n_slots] = intern_ref(ikey);
+
+    return fmt->n_slots++;
+}
+
+static void compile(struct format *fmt, const struct format_tree *tree);
+
+static void compile_subst(struct format *fmt, const struct format_node_subst *s) {
+    const unsigned slot = get_slot(fmt, s->key);
+    unsigned jump_else, jump_end;
+
+    switch (s->type) {
+    case FORMAT_NODE_SUBST_BASIC:
+        emit_op(fmt, FORMAT_OP_VALUE, slot, 0);
+        break;
+    case FORMAT_NODE_SUBST_IF_EXISTS:
+        jump_end = emit_op(fmt, FORMAT_OP_JUMP_IF_ABSENT, slot, 0);
+        compile(fmt, s->if_true);
+        fmt->ops[jump_end].b = fmt->n_ops;
+        break;
+    case FORMAT_NODE_SUBST_IF_ABSENT:
+        jump_end = emit_op(fmt, FORMAT_OP_JUMP_IF_PRESENT, slot, 0);
+        compile(fmt, s->if_false);
+        fmt->ops[jump_end].b = fmt->n_ops;
+        break;
+    case FORMAT_NODE_SUBST_TERNARY:
+        jump_else = emit_op(fmt, FORMAT_OP_JUMP_IF_ABSENT, slot, 0);
+        compile(fmt, s->if_true);
+        jump_end = emit_op(fmt, FORMAT_OP_JUMP, 0, 0);
+        fmt->ops[jump_else].b = fmt->n_ops;
+        compile(fmt, s->if_false);
+        fmt->ops[jump_end].b = fmt->n_ops;
+        break;
+    case FORMAT_NODE_SUBST_FALLBACK:
+        jump_else = emit_op(fmt, FORMAT_OP_JUMP_IF_ABSENT, slot, 0);
+        emit_op(fmt, FORMAT_OP_VALUE, slot, 0);
+        jump_end = emit_op(fmt, FORMAT_OP_JUMP, 0, 0);
+        fmt->ops[jump_else].b = fmt->n_ops;
+        compile(fmt, s->if_false);
+        fmt->ops[jump_end].b = fmt->n_ops;
+        break;
+    }
+}
+
+static void compile(struct format *fmt, const struct format_tree *tree) {
+    for (unsigned i = 0; i < tree->nodes_count; i++) {
+        const struct format_node *node = tree->nodes[i];
+
+        switch (node->type) {
+        case FORMAT_NODE_LITERAL:;
+            const struct wstring *str = &node->as.literal.str;
+            const size_t start = fmt->literals.len;
+            string_appendwsn(&fmt->literals, wstring_data(str), str->len);
+            emit_op(fmt, FORMAT_OP_LITERAL, start, fmt->literals.len - start);
+            break;
+        case FORMAT_NODE_SUBST:
+            compile_subst(fmt, &node->as.subst);
+            break;
+        }
+    }
+}
+
 struct format *format_parse(const char *src, char **error) {
     struct parser p = {
         .src = src,
         .len = strlen(src),
     };
 
-    struct format *f = NULL;
+    struct format_tree *tree = NULL;
 
     if (setjmp(p.jmp_buf)) {
         /* abnormal return */
-        format_free(f);
+        string_free(&p.key);
+        format_tree_free(tree);
         if (error) {
             *error = p.error;
         }
         return NULL;
     }
 
-    parse_format(&p, &f);
+    parse_format(&p, &tree);
     if (!eof(&p)) {
         PARSER_ERROR(&p, "unexpected character: %s", format_wchar(peek(&p)));
     }
 
+    string_free(&p.key);
+
+    struct format *fmt = xzalloc(sizeof(*fmt));
+    compile(fmt, tree);
+    format_tree_free(tree);
+
     if (error) {
         *error = NULL;
     }
-    return f;
+    return fmt;
 }
 
-static void format_node_render(const struct format_node *node,
-                               const struct dict *dict, struct wstring *res) {
-    switch (node->type) {
-    case FORMAT_NODE_LITERAL:
-        wstring_appendwsn(res, node->as.literal.str.data, node->as.literal.str.len);
-        break;
-    case FORMAT_NODE_SUBST:;
-        const char *val = dict_get(dict, node->as.subst.key.data);
-        const struct format *if_true = node->as.subst.if_true;
-        const struct format *if_false = node->as.subst.if_false;
-        switch (node->as.subst.type) {
-        case FORMAT_NODE_SUBST_BASIC:
-            if (val) {
-                wstring_appendsz(res, val);
-            }
+bool format_args_update(const struct format *fmt, struct format_args *args,
+                        const struct dict *dict) {
+    if (!fmt) {
+        return false;
+    }
+
+    bool changed = false;
+    if (!args->filled || args->n_slots != fmt->n_slots) {
+        format_args_free(args);
+        args->filled = true;
+        args->n_slots = fmt->n_slots;
+        args->slots = xcalloc(args->n_slots, sizeof(args->slots[0]));
+        changed = true;
+    }
+
+    for (unsigned i = 0; i < fmt->n_slots; i++) {
+        struct format_arg *arg = &args->slots[i];
+
+        const char *ival = dict_get_interned(dict, fmt->keys[i]);
+        if (ival == arg->ival) {
+            /* both are interned, so the same pointer means the same value */
+            continue;
+        }
+
+        intern_unref(arg->ival);
+        arg->ival = intern_ref(ival);
+        changed = true;
+    }
+
+    return changed;
+}
+
+void format_args_free(struct format_args *args) {
+    for (unsigned i = 0; i < args->n_slots; i++) {
+        intern_unref(args->slots[i].ival);
+    }
+    free(args->slots);
+
+    *args = (struct format_args){0};
+}
+
+void format_render(const struct format *fmt, const struct format_args *args,
+                   struct string *res) {
+    if (!fmt) {
+        return;
+    }
+
+    ASSERT(args->n_slots == fmt->n_slots);
+
+    for (unsigned pc = 0; pc < fmt->n_ops; ) {
+        const struct format_op *op = &fmt->ops[pc++];
+
+        switch (op->type) {
+        case FORMAT_OP_LITERAL:
+            string_appendsn(res, &string_data(&fmt->literals)[op->a], op->b);
             break;
-        case FORMAT_NODE_SUBST_IF_EXISTS:
-            if (val) {
-                format_render(if_true, dict, res);
+        case FORMAT_OP_VALUE:
+            if (args->slots[op->a].ival) {
+                string_appendsz(res, args->slots[op->a].ival);
             }
             break;
-        case FORMAT_NODE_SUBST_IF_ABSENT:
-            if (!val) {
-                format_render(if_false, dict, res);
-            }
+        case FORMAT_OP_JUMP:
+            pc = op->b;
             break;
-        case FORMAT_NODE_SUBST_TERNARY:
-            if (val) {
-                format_render(if_true, dict, res);
-            } else {
-                format_render(if_false, dict, res);
+        case FORMAT_OP_JUMP_IF_ABSENT:
+            if (!args->slots[op->a].ival) {
+                pc = op->b;
             }
             break;
-        case FORMAT_NODE_SUBST_FALLBACK:
-            if (val) {
-                wstring_appendsz(res, val);
-            } else {
-                format_render(if_false, dict, res);
+        case FORMAT_OP_JUMP_IF_PRESENT:
+            if (args->slots[op->a].ival) {
+                pc = op->b;
             }
             break;
         }
-        break;
     }
 }
 
-void format_render(const struct format *fmt, const struct dict *dict, struct wstring *res) {
+bool format_depends_on(const struct format *fmt, const struct dict_changes *changes) {
+    if (!fmt) {
+        return false;
+    } else if (!changes) {
+        /* everything changed, even a format with no keys was never rendered */
+        return true;
+    }
+
+    for (unsigned i = 0; i < fmt->n_slots; i++) {
+        if (dict_changes_has(changes, fmt->keys[i])) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void format_collect_keys(const struct format *fmt, struct dict_keys *keys) {
     if (!fmt) {
         return;
     }
 
-    for (unsigned i = 0; i < fmt->nodes_count; i++) {
-        const struct format_node *node = fmt->nodes[i];
-        format_node_render(node, dict, res);
+    for (unsigned i = 0; i < fmt->n_slots; i++) {
+        dict_keys_add(keys, fmt->keys[i]);
     }
 }
 
@@ -329,23 +503,36 @@ static void format_node_free(struct format_node *node) {
         wstring_free(&node->as.literal.str);
         break;
     case FORMAT_NODE_SUBST:
-        string_free(&node->as.subst.key);
-        format_free(node->as.subst.if_true);
-        format_free(node->as.subst.if_false);
+        intern_unref(node->as.subst.key);
+        format_tree_free(node->as.subst.if_true);
+        format_tree_free(node->as.subst.if_false);
         break;
     }
 
     free(node);
 }
 
+static void format_tree_free(struct format_tree *tree) {
+    if (!tree) {
+        return;
+    }
+
+    for (unsigned i = 0; i < tree->nodes_count; i++) {
+        format_node_free(tree->nodes[i]);
+    }
+    free(tree);
+}
+
 void format_free(struct format *fmt) {
     if (!fmt) {
         return;
     }
 
-    for (unsigned i = 0; i < fmt->nodes_count; i++) {
-        format_node_free(fmt->nodes[i]);
+    for (unsigned i = 0; i < fmt->n_slots; i++) {
+        intern_unref(fmt->keys[i]);
     }
+    free(fmt->keys);
+    free(fmt->ops);
+    string_free(&fmt->literals);
     free(fmt);
 }
-
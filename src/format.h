@@ -1,9 +1,31 @@
 #pragma once
 
 #include "collections/dict.h"
-#include "collections/wstring.h"
+#include "collections/string.h"
 
 struct format *format_parse(const char *src, char **error);
-void format_render(const struct format *format, const struct dict *dict, struct wstring *result);
+
+/* Values of keys referenced by a format */
+struct format_args {
+    bool filled; /* set by the first format_args_update() */
+    unsigned n_slots;
+    struct format_arg {
+        const char *ival; /* interned, NULL if key is absent */
+    } *slots;
+};
+
+/* Looks up every key of format in dict. Returns false if no value differs from the
+ * previous update, so output of format_render() would be the same as last time */
+bool format_args_update(const struct format *format, struct format_args *args,
+                        const struct dict *dict);
+void format_args_free(struct format_args *args);
+
+/* appends UTF-8 output to result */
+void format_render(const struct format *format, const struct format_args *args,
+                   struct string *result);
+/* true if output of format_render() might differ after keys in changes were modified */
+bool format_depends_on(const struct format *format, const struct dict_changes *changes);
+/* adds every key format references, in all branches, to keys */
+void format_collect_keys(const struct format *format, struct dict_keys *keys);
 void format_free(struct format *format);
 
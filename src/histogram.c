@@ -0,0 +1,59 @@
+#include "histogram.h"
+#include "macros.h"
+
+static unsigned bucket_index(uint64_t value) {
+    if (value < HISTOGRAM_SUB_BUCKETS) {
+        return value;
+    }
+
+    /* position of highest set bit, >= HISTOGRAM_SUB_BUCKET_BITS here */
+    const unsigned exp = 63 - __builtin_clzll(value);
+    if (exp >= HISTOGRAM_MAX_BITS) {
+        return HISTOGRAM_BUCKETS - 1;
+    }
+
+    const unsigned shift = exp - HISTOGRAM_SUB_BUCKET_BITS;
+    const unsigned sub = (value >> shift) & (HISTOGRAM_SUB_BUCKETS - 1);
+
+    return (shift + 1) * HISTOGRAM_SUB_BUCKETS + sub;
+}
+
+static uint64_t bucket_upper_bound(unsigned index) {
+    if (index < HISTOGRAM_SUB_BUCKETS) {
+        return index;
+    }
+
+    const unsigned shift = index / HISTOGRAM_SUB_BUCKETS - 1;
+    const uint64_t sub = index % HISTOGRAM_SUB_BUCKETS;
+    const uint64_t lower = (HISTOGRAM_SUB_BUCKETS + sub) << shift;
+
+    return lower + ((uint64_t)1 << shift) - 1;
+}
+
+void histogram_record(struct histogram *hist, uint64_t value) {
+    hist->buckets[bucket_index(value)] += 1;
+
+    hist->min = hist->count ? MIN(hist->min, value) : value;
+    hist->max = MAX(hist->max, value);
+    hist->sum += value;
+    hist->count += 1;
+}
+
+uint64_t histogram_percentile(const struct histogram *hist, double percentile) {
+    if (hist->count == 0) {
+        return 0;
+    }
+
+    uint64_t rank = hist->count * percentile / 100.0;
+    rank = MAX(rank, (uint64_t)1);
+
+    uint64_t seen = 0;
+    for (unsigned i = 0; i < HISTOGRAM_BUCKETS; i++) {
+        seen += hist->buckets[i];
+        if (seen >= rank) {
+            return MIN(bucket_upper_bound(i), hist->max);
+        }
+    }
+
+    return hist->max;
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <stdint.h>
+
+/*
+ * Log-linear histogram in the spirit of HdrHistogram: every power of two is split
+ * into HISTOGRAM_SUB_BUCKETS linear buckets, so any recorded value is known with
+ * relative error of at most 1/HISTOGRAM_SUB_BUCKETS. Values of 2^HISTOGRAM_MAX_BITS
+ * and above all land in the last bucket (exact max is still tracked separately).
+ */
+#define HISTOGRAM_SUB_BUCKET_BITS 4
+#define HISTOGRAM_SUB_BUCKETS (1 << HISTOGRAM_SUB_BUCKET_BITS)
+#define HISTOGRAM_MAX_BITS 36 /* ~68 seconds in nanoseconds */
+#define HISTOGRAM_BUCKETS \
+    ((HISTOGRAM_MAX_BITS - HISTOGRAM_SUB_BUCKET_BITS + 1) * HISTOGRAM_SUB_BUCKETS)
+
+struct histogram {
+    uint64_t count, sum, min, max;
+    uint32_t buckets[HISTOGRAM_BUCKETS];
+};
+
+void histogram_record(struct histogram *hist, uint64_t value);
+/* Returns (upper bound of bucket containing) value at given percentile (0-100),
+ * or 0 if histogram is empty */
+uint64_t histogram_percentile(const struct histogram *hist, double percentile);
@@ -8,8 +8,10 @@
 #include "config.h"
 #include "macros.h"
 #include "eventloop.h"
+#include "events.h"
 #include "tui/tui.h"
 #include "pw/common.h"
+#include "collections/intern.h"
 
 struct pw_main_loop *main_loop = NULL;
 struct pw_loop *event_loop = NULL;
@@ -18,6 +20,18 @@ static void events_fd_handler(void *_, int _, uint32_t _) {
     events_dispatch();
 }
 
+/* called by event loop right before it goes to sleep, so all events queued
+ * during this iteration are dispatched without any extra wakeups */
+static void events_loop_hook(void *_) {
+    events_dispatch();
+}
+
+static const struct spa_loop_control_hooks events_loop_hooks = {
+    .version = SPA_VERSION_LOOP_CONTROL_HOOKS,
+    .before = events_loop_hook,
+};
+static struct spa_hook events_loop_hook_listener;
+
 static void bad_signal_handler(int sig) {
     /* restore terminal state before crashing */
     endwin();
@@ -29,6 +43,12 @@ static void exit_signal_handler(int sig) {
     pw_main_loop_quit(main_loop);
 }
 
+/* called from event loop, not from signal handler context */
+static void on_sigusr1(void *_, int _) {
+    events_log_stats();
+    intern_log_stats();
+}
+
 void print_help_and_exit(FILE *stream, int exit_status) {
     const char help_string[] =
         "pipemixer - pipewire volume control\n"
@@ -158,8 +178,19 @@ int main(int argc, char **argv) {
     }
     event_loop = pw_main_loop_get_loop(main_loop);
 
-    int events_fd = events_global_init();
-    pw_loop_add_io(event_loop, events_fd, POLL_IN, false, events_fd_handler, NULL);
+    if (getenv("PIPEMIXER_EVENTFD_DISPATCH") != NULL) {
+        /* old way, kept as fallback */
+        int events_fd = events_global_init(EVENTS_DISPATCH_EVENTFD);
+        if (events_fd < 0) {
+            fprintf(stderr, "failed to create eventfd: %s\n", strerror(errno));
+            retcode = 1;
+            goto cleanup;
+        }
+        pw_loop_add_io(event_loop, events_fd, POLL_IN, false, events_fd_handler, NULL);
+    } else {
+        events_global_init(EVENTS_DISPATCH_LOOP_HOOK);
+        pw_loop_add_hook(event_loop, &events_loop_hook_listener, &events_loop_hooks, NULL);
+    }
 
     /* naming is unfortunate */
     if (!pipewire_init()) {
@@ -189,6 +220,8 @@ int main(int argc, char **argv) {
         }, NULL);
     }
 
+    pw_loop_add_signal(event_loop, SIGUSR1, on_sigusr1, NULL);
+
     tui_init();
 
     TRACE("entering main loop");
@@ -196,6 +229,9 @@ int main(int argc, char **argv) {
     TRACE("leaving main loop");
 
 cleanup:
+    events_log_stats();
+    intern_log_stats();
+
     pipewire_cleanup();
     tui_cleanup();
 
@@ -35,6 +35,13 @@ struct pipewire {
 
     struct map nodes, devices;
 
+    /* registry changes are batched until a core roundtrip completes without new ones */
+    struct {
+        bool active;
+        bool changed; /* registry changed after sync was issued */
+        int sync_seq;
+    } batch;
+
     struct event_emitter *emitter;
 } pw = {0};
 
@@ -42,6 +49,7 @@ enum pipewire_event_types {
     PIPEWIRE_EVENT_NODE,
     PIPEWIRE_EVENT_DEVICE,
     PIPEWIRE_EVENT_DEFAULT,
+    PIPEWIRE_EVENT_BATCH,
 };
 
 static void pipewire_event_dispatcher(uint64_t id, union event_data data,
@@ -66,11 +74,29 @@ static void pipewire_event_dispatcher(uint64_t id, union event_data data,
         EVENT_DISPATCH(table->default_, key, md->properties[key], callbacks_data);
         break;
     }
+    case PIPEWIRE_EVENT_BATCH: {
+        EVENT_DISPATCH(table->batch, data.b, callbacks_data);
+        break;
+    }
     default:
         ERROR("unexpected pipewire event %"PRIu64, id);
     }
 }
 
+static const char *const pipewire_event_names[] = {
+    [PIPEWIRE_EVENT_NODE] = "node",
+    [PIPEWIRE_EVENT_DEVICE] = "device",
+    [PIPEWIRE_EVENT_DEFAULT] = "default",
+    [PIPEWIRE_EVENT_BATCH] = "batch",
+};
+
+static const struct event_emitter_type pipewire_emitter_type = {
+    .name = "pipewire",
+    .dispatcher = pipewire_event_dispatcher,
+    .event_names = pipewire_event_names,
+    .n_events = SIZEOF_ARRAY(pipewire_event_names),
+};
+
 static void after_emit_node(union event_data data) {
     node_unref((struct node **)&data.p);
 }
@@ -91,9 +117,41 @@ static void emit_default(enum default_metadata_key key, struct event_hook *hook)
     event_emit(pw.emitter, hook, PIPEWIRE_EVENT_DEFAULT, NULL, 'u', key);
 }
 
+/* notifies default listeners of node that used to be default and node that is default now */
+static void emit_default_keyed(enum default_metadata_key key, const char *old_name) {
+    const char *new_name = pw.default_metadata.properties[key];
+
+    if (old_name != NULL) {
+        event_emit_keyed(pw.emitter, str_hash(old_name), PIPEWIRE_EVENT_DEFAULT, NULL, 'u', key);
+    }
+    if (new_name != NULL && (old_name == NULL || str_hash(new_name) != str_hash(old_name))) {
+        event_emit_keyed(pw.emitter, str_hash(new_name), PIPEWIRE_EVENT_DEFAULT, NULL, 'u', key);
+    }
+}
+
+static void emit_batch(bool active, struct event_hook *hook) {
+    event_emit(pw.emitter, hook, PIPEWIRE_EVENT_BATCH, NULL, 'b', active);
+}
+
+/* called on every registry change, batch ends in on_core_done */
+static void batch_touch(void) {
+    if (!pw.batch.active) {
+        DEBUG("registry batch start");
+        pw.batch.active = true;
+        pw.batch.sync_seq = pw_core_sync(pw.core, PW_ID_CORE, pw.batch.sync_seq);
+        emit_batch(true, NULL);
+    } else {
+        pw.batch.changed = true;
+    }
+}
+
 struct event_hook *pipewire_add_listener(const struct pipewire_events *events, void *data) {
     struct event_hook *hook = event_emitter_add_hook(pw.emitter, events, data, NULL, NULL);
 
+    if (pw.batch.active) {
+        emit_batch(true, hook);
+    }
+
     struct node *node;
     MAP_FOREACH(&pw.nodes, &node) {
         emit_node(node, hook);
@@ -113,6 +171,21 @@ struct event_hook *pipewire_add_listener(const struct pipewire_events *events, v
     return hook;
 }
 
+struct event_hook *pipewire_add_default_listener(const char *node_name,
+                                                 const struct pipewire_events *events,
+                                                 void *data) {
+    struct event_hook *hook = event_emitter_add_keyed_hook(pw.emitter, str_hash(node_name),
+                                                           events, data, NULL, NULL);
+
+    if (pw.default_metadata.pw_metadata) {
+        for (unsigned i = 0; i < DEFAULT_METADATA_KEY_COUNT; i++) {
+            emit_default(i, hook);
+        }
+    }
+
+    return hook;
+}
+
 struct node *node_lookup(uint32_t id) {
     struct node *node = map_get(&pw.nodes, id);
     if (!node) {
@@ -129,6 +202,26 @@ struct device *device_lookup(uint32_t id) {
     return device;
 }
 
+void pipewire_props_assign(struct dict *dict, const struct spa_dict *props,
+                           const struct dict_keys *only, struct dict_changes *changes) {
+    /* props come from the other side of the socket, so their size is not trusted
+     * to fit on the stack. Typical nodes and devices have a few dozen */
+    struct dict_item_ref stack_items[64];
+    struct dict_item_ref *items = stack_items;
+    if (props->n_items > SIZEOF_ARRAY(stack_items)) {
+        items = xcalloc(props->n_items, sizeof(items[0]));
+    }
+
+    for (unsigned i = 0; i < props->n_items; i++) {
+        items[i] = (struct dict_item_ref){ props->items[i].key, props->items[i].value };
+    }
+    dict_assign(dict, items, props->n_items, only, changes);
+
+    if (items != stack_items) {
+        free(items);
+    }
+}
+
 static const char *default_metadata_key_str(enum default_metadata_key key) {
     static const char *const keys[] = {
         [DEFAULT_AUDIO_SINK] = "default.audio.sink",
@@ -182,9 +275,11 @@ static int on_default_metadata_property(void *data, uint32_t id, const char *key
 
     for (unsigned i = 0; i < DEFAULT_METADATA_KEY_COUNT; i++) {
         if (streq(key, default_metadata_key_str(i))) {
-            free(md->properties[i]);
+            char *old_name = md->properties[i];
             xasprintf(&md->properties[i], "%.*s", name_len, name);
             emit_default(i, NULL);
+            emit_default_keyed(i, old_name);
+            free(old_name);
             break;
         }
     }
@@ -221,6 +316,10 @@ static void on_registry_global(void *data, uint32_t id, uint32_t permissions,
             return;
         }
 
+        /* only objects that end up in the UI start a batch, ports, links, clients
+         * and filtered out nodes come and go all the time */
+        batch_touch();
+
         struct pw_node *pw_node = pw_registry_bind(pw.registry, id, type, PW_VERSION_NODE, 0);
         struct node *node = node_create(pw_node, id, media_class_value);
         map_insert(&pw.nodes, id, node);
@@ -237,6 +336,8 @@ static void on_registry_global(void *data, uint32_t id, uint32_t permissions,
             return;
         }
 
+        batch_touch();
+
         struct pw_device *pw_device = pw_registry_bind(pw.registry, id, type, PW_VERSION_DEVICE, 0);
         struct device *device = device_create(pw_device, id);
         map_insert(&pw.devices, id, device);
@@ -263,6 +364,7 @@ static void on_registry_global_remove(void *data, uint32_t id) {
     struct node *node = map_remove(&pw.nodes, id);
     if (node) {
         TRACE("registry global_remove: found node %u", id);
+        batch_touch();
         node_unref(&node);
         return;
     }
@@ -270,6 +372,7 @@ static void on_registry_global_remove(void *data, uint32_t id) {
     struct device *device = map_remove(&pw.devices, id);
     if (device) {
         TRACE("registry global_remove: found device %u", id);
+        batch_touch();
         device_unref(&device);
         return;
     }
@@ -285,8 +388,25 @@ static void on_core_error(void *data, uint32_t id, int seq, int res, const char
     ERROR("core error %d on object %d: %d (%s)", seq, id, res, message);
 }
 
+static void on_core_done(void *data, uint32_t id, int seq) {
+    if (id != PW_ID_CORE || !pw.batch.active || seq != pw.batch.sync_seq) {
+        return;
+    }
+
+    if (pw.batch.changed) {
+        /* more changes arrived while waiting, wait for them to settle too */
+        pw.batch.changed = false;
+        pw.batch.sync_seq = pw_core_sync(pw.core, PW_ID_CORE, pw.batch.sync_seq);
+    } else {
+        DEBUG("registry batch end");
+        pw.batch.active = false;
+        emit_batch(false, NULL);
+    }
+}
+
 static const struct pw_core_events core_events = {
     .version = PW_VERSION_CORE_EVENTS,
+    .done = on_core_done,
     .error = on_core_error,
 };
 
@@ -307,7 +427,10 @@ bool pipewire_init(void) {
     pw.registry = pw_core_get_registry(pw.core, PW_VERSION_REGISTRY, 0);
     pw_registry_add_listener(pw.registry, &pw.registry_listener, &registry_events, NULL);
 
-    pw.emitter = event_emitter_create(pipewire_event_dispatcher);
+    pw.emitter = event_emitter_create(&pipewire_emitter_type);
+
+    /* registry is about to dump all existing objects */
+    batch_touch();
 
     return true;
 }
@@ -7,6 +7,7 @@
 #include "pw/node.h"
 #include "pw/device.h"
 #include "pw/types.h"
+#include "collections/dict.h"
 
 enum default_metadata_key {
     DEFAULT_AUDIO_SOURCE,
@@ -25,11 +26,23 @@ struct device *device_lookup(pw_id_t id);
 
 void pipewire_set_default(enum default_metadata_key key, const char *value);
 
+/* dict_assign() for props received from pipewire */
+void pipewire_props_assign(struct dict *dict, const struct spa_dict *props,
+                           const struct dict_keys *only, struct dict_changes *changes);
+
 struct pipewire_events {
     void (*node)(struct node *node, void *data);
     void (*device)(struct device *dev, void *data);
     void (*default_)(enum default_metadata_key key, const char *val, void *data);
+    /* active is true while a burst of objects being added or removed is in flight
+     * (startup, pipewire or session manager restart) and false once it has settled */
+    void (*batch)(bool active, void *data);
 };
 
 struct event_hook *pipewire_add_listener(const struct pipewire_events *events, void *data);
+/* Only gets default_ events that might concern node with given node.name,
+ * that is when node_name becomes default or stops being default */
+struct event_hook *pipewire_add_default_listener(const char *node_name,
+                                                 const struct pipewire_events *events,
+                                                 void *data);
 
@@ -4,7 +4,9 @@
 #include <spa/param/audio/raw-types.h>
 
 #include "pw/device.h"
+#include "pw/common.h"
 #include "collections/vec.h"
+#include "collections/intern.h"
 #include "log.h"
 #include "xmalloc.h"
 #include "macros.h"
@@ -19,9 +21,12 @@ struct device {
 
     uint32_t id;
     struct dict props;
+    /* keys changed since props event was last emitted, shared with queued events */
+    struct dict_changes *props_changes;
 
-    VEC(struct param_route) routes;
-    VEC(struct param_profile) profiles;
+    /* published, shared with nodes and listeners, NULL until first roundtrip */
+    struct param_routes *routes;
+    struct param_profiles *profiles;
 
     /* needed to atomically update routes and profiles */
     struct {
@@ -38,13 +43,51 @@ struct device {
     unsigned refcnt;
 };
 
+/* only these props keys are stored, device.c itself doesn't read any */
+static struct dict_keys props_keys;
+
+void device_keep_props_keys(const struct dict_keys *keys) {
+    for (size_t i = 0; i < keys->size; i++) {
+        dict_keys_add(&props_keys, keys->data[i]);
+    }
+}
+
 enum device_event_types {
     DEVICE_EVENT_REMOVED,
     DEVICE_EVENT_PROPS,
     DEVICE_EVENT_ROUTES,
     DEVICE_EVENT_PROFILES,
+    DEVICE_EVENT_SNAPSHOT,
 };
 
+static void device_dispatch_snapshot(struct device *dev, const struct device_events *table,
+                                     void *callbacks_data) {
+    const struct device_snapshot snapshot = {
+        .has_props = dev->has_props,
+        .props = &dev->props,
+        .has_routes = dev->has_routes,
+        .routes = dev->routes,
+        .has_profiles = dev->has_profiles,
+        .profiles = dev->profiles,
+    };
+
+    if (table->snapshot) {
+        table->snapshot(dev, &snapshot, callbacks_data);
+        return;
+    }
+
+    /* listener doesn't care, deliver everything separately */
+    if (snapshot.has_props) {
+        EVENT_DISPATCH(table->props, dev, snapshot.props, NULL, callbacks_data);
+    }
+    if (snapshot.has_profiles) {
+        EVENT_DISPATCH(table->profiles, dev, snapshot.profiles, callbacks_data);
+    }
+    if (snapshot.has_routes) {
+        EVENT_DISPATCH(table->routes, dev, snapshot.routes, callbacks_data);
+    }
+}
+
 static void device_event_dispatcher(uint64_t id, union event_data data,
                                     const void *callbacks, void *callbacks_data,
                                     void *private_data) {
@@ -57,19 +100,19 @@ static void device_event_dispatcher(uint64_t id, union event_data data,
         break;
     }
     case DEVICE_EVENT_PROPS: {
-        EVENT_DISPATCH(table->props, dev, &dev->props, callbacks_data);
+        EVENT_DISPATCH(table->props, dev, &dev->props, data.p, callbacks_data);
         break;
     }
     case DEVICE_EVENT_ROUTES: {
-        EVENT_DISPATCH(table->routes, dev,
-                       dev->routes.data, dev->routes.size,
-                       callbacks_data);
+        EVENT_DISPATCH(table->routes, dev, dev->routes, callbacks_data);
         break;
     }
     case DEVICE_EVENT_PROFILES: {
-        EVENT_DISPATCH(table->profiles, dev,
-                       dev->profiles.data, dev->profiles.size,
-                       callbacks_data);
+        EVENT_DISPATCH(table->profiles, dev, dev->profiles, callbacks_data);
+        break;
+    }
+    case DEVICE_EVENT_SNAPSHOT: {
+        device_dispatch_snapshot(dev, table, callbacks_data);
         break;
     }
     default:
@@ -77,20 +120,44 @@ static void device_event_dispatcher(uint64_t id, union event_data data,
     }
 }
 
+static const char *const device_event_names[] = {
+    [DEVICE_EVENT_REMOVED] = "removed",
+    [DEVICE_EVENT_PROPS] = "props",
+    [DEVICE_EVENT_ROUTES] = "routes",
+    [DEVICE_EVENT_PROFILES] = "profiles",
+    [DEVICE_EVENT_SNAPSHOT] = "snapshot",
+};
+
+static const struct event_emitter_type device_emitter_type = {
+    .name = "device",
+    .dispatcher = device_event_dispatcher,
+    .event_names = device_event_names,
+    .n_events = SIZEOF_ARRAY(device_event_names),
+};
+
 static void emit_removed(struct device *dev, struct event_hook *hook) {
     event_emit(dev->emitter, hook, DEVICE_EVENT_REMOVED, NULL, '0');
 }
 
+static void after_emit_props(union event_data data) {
+    dict_changes_unref((struct dict_changes **)&data.p);
+}
+
 static void emit_props(struct device *dev, struct event_hook *hook) {
-    event_emit(dev->emitter, hook, DEVICE_EVENT_PROPS, NULL, '0');
+    event_emit_coalescing(dev->emitter, hook, DEVICE_EVENT_PROPS, after_emit_props,
+                          'p', dict_changes_ref(dev->props_changes));
 }
 
 static void emit_routes(struct device *dev, struct event_hook *hook) {
-    event_emit(dev->emitter, hook, DEVICE_EVENT_ROUTES, NULL, '0');
+    event_emit_coalescing(dev->emitter, hook, DEVICE_EVENT_ROUTES, NULL, '0');
 }
 
 static void emit_profiles(struct device *dev, struct event_hook *hook) {
-    event_emit(dev->emitter, hook, DEVICE_EVENT_PROFILES, NULL, '0');
+    event_emit_coalescing(dev->emitter, hook, DEVICE_EVENT_PROFILES, NULL, '0');
+}
+
+static void emit_snapshot(struct device *dev, struct event_hook *hook) {
+    event_emit_coalescing(dev->emitter, hook, DEVICE_EVENT_SNAPSHOT, NULL, '0');
 }
 
 static void hook_remove(void *private_data) {
@@ -104,14 +171,8 @@ struct event_hook *device_add_listener(struct device *dev,
     struct event_hook *hook = event_emitter_add_hook(dev->emitter, events, data,
                                                      hook_remove, device_ref(dev));
 
-    if (dev->has_props) {
-        emit_props(dev, hook);
-    }
-    if (dev->has_profiles) {
-        emit_profiles(dev, hook);
-    }
-    if (dev->has_routes) {
-        emit_routes(dev, hook);
+    if (dev->has_props || dev->has_profiles || dev->has_routes) {
+        emit_snapshot(dev, hook);
     }
 
     return hook;
@@ -234,8 +295,8 @@ static void on_device_param_enum_route(struct device *dev, const struct spa_pod
     *new_route = (struct param_route){
         .index = index,
         .direction = direction,
-        .name = xstrdup(name),
-        .description = xstrdup(description),
+        .name = intern(name),
+        .description = intern(description),
         .n_devices = dev_nvals,
         .devices = xmemduparray(dev_vals, dev_nvals, dev_csize),
         .n_profiles = prof_nvals,
@@ -267,8 +328,8 @@ static void on_device_param_enum_profile(struct device *dev, const struct spa_po
     struct param_profile *new_profile = VEC_APPEND(&dev->staging.profiles);
     *new_profile = (struct param_profile){
         .index = index,
-        .description = xstrdup(description),
-        .name = xstrdup(name),
+        .description = intern(description),
+        .name = intern(name),
     };
 
     DEBUG("dev %d EnumProfile: index=%d name=%s desc=%s",
@@ -341,14 +402,17 @@ static void on_device_info(void *data, const struct pw_device_info *info) {
     if (info->change_mask & PW_DEVICE_CHANGE_MASK_PROPS) {
         const struct spa_dict *props = info->props;
 
-        dict_clear(&dev->props);
-        dict_reserve(&dev->props, props->n_items);
-        for (unsigned i = 0; i < props->n_items; i++) {
-            const struct spa_dict_item *item = &props->items[i];
-            dict_insert(&dev->props, item->key, item->value);
+        /* see on_node_info() */
+        if (dev->props_changes->refcnt == 1) {
+            dict_changes_clear(dev->props_changes);
         }
 
-        emit_props(dev, NULL);
+        const size_t n_changes = dev->props_changes->keys.size;
+        pipewire_props_assign(&dev->props, props, &props_keys, dev->props_changes);
+
+        if (dev->props_changes->keys.size > n_changes || !dev->has_props) {
+            emit_props(dev, NULL);
+        }
         dev->has_props = true;
     }
 
@@ -394,27 +458,56 @@ const struct pw_device_events device_events = {
     .param = on_device_param,
 };
 
-static void on_proxy_roundtrip_done(void *data, int _) {
-    struct device *dev = data;
+/* Moves staged routes into a new array. Returns false if it is the same as the
+ * published one, which is then kept so that everyone holding it can tell nothing changed */
+static bool publish_routes(struct device *dev) {
+    struct param_routes *routes = param_routes_create(dev->staging.routes.size);
+    VEC_FOREACH(&dev->staging.routes, i) {
+        routes->items[i] = dev->staging.routes.data[i];
+    }
+    VEC_CLEAR(&dev->staging.routes);
 
-    VEC_FOREACH(&dev->routes, i) {
-        struct param_route *route = &dev->routes.data[i];
-        param_route_free_contents(route);
+    if (dev->has_routes && param_routes_equal(routes, dev->routes)) {
+        param_routes_unref(&routes);
+        return false;
     }
-    VEC_CLEAR(&dev->routes);
-    VEC_EXCHANGE(&dev->routes, &dev->staging.routes);
 
-    VEC_FOREACH(&dev->profiles, i) {
-        struct param_profile *profile = &dev->profiles.data[i];
-        param_profile_free_contents(profile);
+    param_routes_unref(&dev->routes);
+    dev->routes = routes;
+    return true;
+}
+
+/* see publish_routes() */
+static bool publish_profiles(struct device *dev) {
+    struct param_profiles *profiles = param_profiles_create(dev->staging.profiles.size);
+    VEC_FOREACH(&dev->staging.profiles, i) {
+        profiles->items[i] = dev->staging.profiles.data[i];
+    }
+    VEC_CLEAR(&dev->staging.profiles);
+
+    if (dev->has_profiles && param_profiles_equal(profiles, dev->profiles)) {
+        param_profiles_unref(&profiles);
+        return false;
     }
-    VEC_CLEAR(&dev->profiles);
-    VEC_EXCHANGE(&dev->profiles, &dev->staging.profiles);
 
-    emit_profiles(dev, NULL);
-    dev->has_profiles = true;
-    emit_routes(dev, NULL);
-    dev->has_routes = true;
+    param_profiles_unref(&dev->profiles);
+    dev->profiles = profiles;
+    return true;
+}
+
+static void on_proxy_roundtrip_done(void *data, int _) {
+    struct device *dev = data;
+
+    /* Route params also change when route volume does, so most of the time
+     * the enumeration brings back exactly what we already have */
+    if (publish_profiles(dev)) {
+        emit_profiles(dev, NULL);
+        dev->has_profiles = true;
+    }
+    if (publish_routes(dev)) {
+        emit_routes(dev, NULL);
+        dev->has_routes = true;
+    }
 }
 
 static void on_proxy_removed(void *data) {
@@ -438,7 +531,8 @@ struct device *device_create(struct pw_device *pw_device, uint32_t id) {
         .refcnt = 1,
     };
 
-    dev->emitter = event_emitter_create(device_event_dispatcher);
+    dev->emitter = event_emitter_create(&device_emitter_type);
+    dev->props_changes = dict_changes_create();
 
     pw_device_add_listener(dev->pw_device, &dev->listener, &device_events, dev);
     pw_proxy_add_listener(dev->pw_proxy, &dev->proxy_listener, &proxy_events, dev);
@@ -450,18 +544,10 @@ static void device_destroy(struct device *device) {
     pw_proxy_destroy(device->pw_proxy);
 
     dict_free(&device->props);
+    dict_changes_unref(&device->props_changes);
 
-    VEC_FOREACH(&device->routes, i) {
-        struct param_route *route = &device->routes.data[i];
-        param_route_free_contents(route);
-    }
-    VEC_FREE(&device->routes);
-
-    VEC_FOREACH(&device->profiles, i) {
-        struct param_profile *profile = &device->profiles.data[i];
-        param_profile_free_contents(profile);
-    }
-    VEC_FREE(&device->profiles);
+    param_routes_unref(&device->routes);
+    param_profiles_unref(&device->profiles);
 
     /* staging */
     VEC_FOREACH(&device->staging.routes, i) {
@@ -8,6 +8,9 @@
 
 struct device;
 
+/* see node_keep_props_keys() */
+void device_keep_props_keys(const struct dict_keys *keys);
+
 struct device *device_create(struct pw_device *pw_device, uint32_t id);
 
 struct device *device_ref(struct device *dev);
@@ -22,15 +25,31 @@ void device_set_route(const struct device *dev, int32_t card_profile_device, int
 
 void device_set_profile(const struct device *dev, int32_t index);
 
+/* Everything currently known about a device. Each group of fields is only valid if
+ * the corresponding has_ flag is set */
+struct device_snapshot {
+    bool has_props;
+    const struct dict *props;
+
+    bool has_routes;
+    const struct param_routes *routes;
+
+    bool has_profiles;
+    const struct param_profiles *profiles;
+};
+
 struct device_events {
+    /* Sent once to a new listener instead of separate props, routes and profiles events.
+     * If NULL, those callbacks are called instead */
+    void (*snapshot)(struct device *dev, const struct device_snapshot *snapshot, void *data);
     void (*removed)(struct device *dev, void *data);
-    void (*props)(struct device *dev, const struct dict *props, void *data);
-    void (*routes)(struct device *dev,
-                   const struct param_route routes[], unsigned routes_count,
-                   void *data);
-    void (*profiles)(struct device *dev,
-                     const struct param_profile profiles[], unsigned profiles_count,
-                     void *data);
+    /* see node_events.props */
+    void (*props)(struct device *dev, const struct dict *props,
+                  const struct dict_changes *changed, void *data);
+    /* Only sent when something actually changed. Arrays are immutable, take a reference
+     * with param_routes_ref() or param_profiles_ref() to keep one past the callback */
+    void (*routes)(struct device *dev, const struct param_routes *routes, void *data);
+    void (*profiles)(struct device *dev, const struct param_profiles *profiles, void *data);
 };
 
 struct event_hook *device_add_listener(struct device *dev,
@@ -10,6 +10,7 @@
 #include "pw/node.h"
 #include "pw/device.h"
 #include "pw/common.h"
+#include "collections/intern.h"
 #include "log.h"
 #include "xmalloc.h"
 #include "macros.h"
@@ -27,19 +28,26 @@ struct node {
     uint32_t id;
     enum media_class media_class;
     struct dict props;
+    /* keys changed since props event was last emitted, shared with queued events */
+    struct dict_changes *props_changes;
 
     struct param_props param_props;
 
     bool is_default;
     struct event_hook *default_hook;
+    /* interned node.name default_hook is keyed by */
+    const char *default_hook_name;
 
     uint32_t device_id;
     struct device *device;
     struct event_hook *device_hook;
 
     int32_t card_profile_device, device_profile;
-    unsigned n_routes;
-    struct param_route *routes, *active_route;
+    /* last routes of the device, needed to pick them again when active profile changes */
+    struct param_routes *device_routes;
+    /* routes of this node, shared with listeners */
+    struct param_routes *routes;
+    const struct param_route *active_route;
 
     struct event_emitter *emitter;
 
@@ -51,6 +59,34 @@ struct node {
     unsigned refcnt;
 };
 
+/* props keys node.c reads itself */
+static const char *const own_props_keys[] = {
+    "node.name",
+    "card.profile.device",
+    "device.id",
+};
+
+/* only these props keys are stored, see node_keep_props_keys() */
+static struct dict_keys props_keys;
+
+static void add_own_props_keys(void) {
+    if (props_keys.size > 0) {
+        return;
+    }
+
+    for (unsigned i = 0; i < SIZEOF_ARRAY(own_props_keys); i++) {
+        dict_keys_add(&props_keys, own_props_keys[i]);
+    }
+}
+
+void node_keep_props_keys(const struct dict_keys *keys) {
+    add_own_props_keys();
+
+    for (size_t i = 0; i < keys->size; i++) {
+        dict_keys_add(&props_keys, keys->data[i]);
+    }
+}
+
 enum node_event_types {
     NODE_EVENT_REMOVED,
     NODE_EVENT_ROUTES,
@@ -59,8 +95,49 @@ enum node_event_types {
     NODE_EVENT_VOLUME,
     NODE_EVENT_MUTE,
     NODE_EVENT_DEFAULT,
+    NODE_EVENT_SNAPSHOT,
 };
 
+static void node_dispatch_snapshot(struct node *node, const struct node_events *table,
+                                   void *callbacks_data) {
+    const struct node_snapshot snapshot = {
+        .has_props = node->has_props,
+        .props = &node->props,
+        .has_routes = node->has_routes,
+        .routes = node->routes,
+        .has_param_props = node->has_param_props,
+        .channel_names = node->param_props.channel_names,
+        .channel_volumes = node->param_props.channel_volumes,
+        .channel_count = node->param_props.n_channels,
+        .mute = node->param_props.mute,
+        .has_default = node->has_default,
+        .is_default = node->is_default,
+    };
+
+    if (table->snapshot) {
+        table->snapshot(node, &snapshot, callbacks_data);
+        return;
+    }
+
+    /* listener doesn't care, deliver everything separately */
+    if (snapshot.has_props) {
+        EVENT_DISPATCH(table->props, node, snapshot.props, NULL, callbacks_data);
+    }
+    if (snapshot.has_routes) {
+        EVENT_DISPATCH(table->routes, node, snapshot.routes, callbacks_data);
+    }
+    if (snapshot.has_param_props) {
+        EVENT_DISPATCH(table->channels, node, snapshot.channel_names, snapshot.channel_count,
+                       callbacks_data);
+        EVENT_DISPATCH(table->volume, node, snapshot.channel_volumes, snapshot.channel_count,
+                       callbacks_data);
+        EVENT_DISPATCH(table->mute, node, snapshot.mute, callbacks_data);
+    }
+    if (snapshot.has_default) {
+        EVENT_DISPATCH(table->default_, node, snapshot.is_default, callbacks_data);
+    }
+}
+
 static void node_event_dispatcher(uint64_t id, union event_data data,
                                   const void *callbacks, void *callbacks_data,
                                   void *private_data) {
@@ -72,10 +149,10 @@ static void node_event_dispatcher(uint64_t id, union event_data data,
         EVENT_DISPATCH(table->removed, node, callbacks_data);
         break;
     case NODE_EVENT_ROUTES:
-        EVENT_DISPATCH(table->routes, node, node->routes, node->n_routes, callbacks_data);
+        EVENT_DISPATCH(table->routes, node, node->routes, callbacks_data);
         break;
     case NODE_EVENT_PROPS:
-        EVENT_DISPATCH(table->props, node, &node->props, callbacks_data);
+        EVENT_DISPATCH(table->props, node, &node->props, data.p, callbacks_data);
         break;
     case NODE_EVENT_CHANNELS:
         EVENT_DISPATCH(table->channels, node,
@@ -93,38 +170,68 @@ static void node_event_dispatcher(uint64_t id, union event_data data,
     case NODE_EVENT_DEFAULT:
         EVENT_DISPATCH(table->default_, node, node->is_default, callbacks_data);
         break;
+    case NODE_EVENT_SNAPSHOT:
+        node_dispatch_snapshot(node, table, callbacks_data);
+        break;
     default:
         ERROR("unexpected node event id %"PRIu64, id);
     }
 }
 
+static const char *const node_event_names[] = {
+    [NODE_EVENT_REMOVED] = "removed",
+    [NODE_EVENT_ROUTES] = "routes",
+    [NODE_EVENT_PROPS] = "props",
+    [NODE_EVENT_CHANNELS] = "channels",
+    [NODE_EVENT_VOLUME] = "volume",
+    [NODE_EVENT_MUTE] = "mute",
+    [NODE_EVENT_DEFAULT] = "default",
+    [NODE_EVENT_SNAPSHOT] = "snapshot",
+};
+
+static const struct event_emitter_type node_emitter_type = {
+    .name = "node",
+    .dispatcher = node_event_dispatcher,
+    .event_names = node_event_names,
+    .n_events = SIZEOF_ARRAY(node_event_names),
+};
+
 static void emit_removed(struct node *node, struct event_hook *hook) {
     TRACE("node emit_removed(%p)", node);
     event_emit(node->emitter, hook, NODE_EVENT_REMOVED, NULL, '0');
 }
 
 static void emit_routes(struct node *node, struct event_hook *hook) {
-    event_emit(node->emitter, hook, NODE_EVENT_ROUTES, NULL, '0');
+    event_emit_coalescing(node->emitter, hook, NODE_EVENT_ROUTES, NULL, '0');
+}
+
+static void after_emit_props(union event_data data) {
+    dict_changes_unref((struct dict_changes **)&data.p);
 }
 
 static void emit_props(struct node *node, struct event_hook *hook) {
-    event_emit(node->emitter, hook, NODE_EVENT_PROPS, NULL, '0');
+    event_emit_coalescing(node->emitter, hook, NODE_EVENT_PROPS, after_emit_props,
+                          'p', dict_changes_ref(node->props_changes));
 }
 
 static void emit_channels(struct node *node, struct event_hook *hook) {
-    event_emit(node->emitter, hook, NODE_EVENT_CHANNELS, NULL, '0');
+    event_emit_coalescing(node->emitter, hook, NODE_EVENT_CHANNELS, NULL, '0');
 }
 
 static void emit_volume(struct node *node, struct event_hook *hook) {
-    event_emit(node->emitter, hook, NODE_EVENT_VOLUME, NULL, '0');
+    event_emit_coalescing(node->emitter, hook, NODE_EVENT_VOLUME, NULL, '0');
 }
 
 static void emit_mute(struct node *node, struct event_hook *hook) {
-    event_emit(node->emitter, hook, NODE_EVENT_MUTE, NULL, '0');
+    event_emit_coalescing(node->emitter, hook, NODE_EVENT_MUTE, NULL, '0');
 }
 
 static void emit_default(struct node *node, struct event_hook *hook) {
-    event_emit(node->emitter, hook, NODE_EVENT_DEFAULT, NULL, '0');
+    event_emit_coalescing(node->emitter, hook, NODE_EVENT_DEFAULT, NULL, '0');
+}
+
+static void emit_snapshot(struct node *node, struct event_hook *hook) {
+    event_emit_coalescing(node->emitter, hook, NODE_EVENT_SNAPSHOT, NULL, '0');
 }
 
 static void hook_remove(void *private_data) {
@@ -135,19 +242,8 @@ static void hook_remove(void *private_data) {
 struct event_hook *node_add_listener(struct node *node, const struct node_events *ev, void *data) {
     struct event_hook *hook = event_emitter_add_hook(node->emitter, ev, data,
                                                      hook_remove, node_ref(node));
-    if (node->has_props) {
-        emit_props(node, hook);
-    }
-    if (node->has_routes) {
-        emit_routes(node, hook);
-    }
-    if (node->has_param_props) {
-        emit_channels(node, hook);
-        emit_volume(node, hook);
-        emit_mute(node, hook);
-    }
-    if (node->has_default) {
-        emit_default(node, hook);
+    if (node->has_props || node->has_routes || node->has_param_props || node->has_default) {
+        emit_snapshot(node, hook);
     }
 
     return hook;
@@ -297,31 +393,23 @@ static int int32_cmp(const void *a, const void *b) {
     return (*(int32_t *)a != *(int32_t *)b);
 }
 
-static void on_device_routes(struct device *dev,
-                             const struct param_route *routes, unsigned len, void *data) {
-    struct node *node = data;
-
-    DEBUG("node %u dev %u routes: count=%u", node->id, device_id(dev), len);
-
-    for (unsigned i = 0; i < node->n_routes; i++) {
-        struct param_route *route = &node->routes[i];
-        param_route_free_contents(route);
-    }
-
-    node->routes = xreallocarray(node->routes, len, sizeof(node->routes[0]));
-    node->active_route = NULL;
-    node->n_routes = 0;
+/* Picks routes of the device that belong to this node. Emits routes event if the result
+ * differs from the current one */
+static void update_routes(struct node *node) {
+    const struct param_routes *all = node->device_routes;
+    struct param_routes *routes = param_routes_create(all->count);
+    unsigned n = 0;
 
     /* I wish I could explain what is happening here, but I don't even fully
      * understand it myself. Pipewire's surreal and incomprehensible nature
      * simply cannot be put into words. */
-    for (unsigned i = 0; i < len; i++) {
-        const struct param_route *route = &routes[i];
+    for (unsigned i = 0; i < all->count; i++) {
+        const struct param_route *route = &all->items[i];
 
         const bool same_direction = route->direction == media_class_to_direction(node->media_class);
         if (!same_direction) {
             DEBUG("node %u dev %u routes: idx=%d dev=%d dir=%d act=%d: SKIP(direction)",
-                  node->id, device_id(dev),
+                  node->id, node->device_id,
                   route->index, route->device, route->direction, route->active);
             continue;
         }
@@ -330,7 +418,7 @@ static void on_device_routes(struct device *dev,
                                       &(size_t){route->n_devices}, sizeof(int32_t), int32_cmp);
         if (!has_device) {
             DEBUG("node %u dev %u routes: idx=%d dev=%d dir=%d act=%d: SKIP(devices)",
-                  node->id, device_id(dev),
+                  node->id, node->device_id,
                   route->index, route->device, route->direction, route->active);
             continue;
         }
@@ -339,55 +427,86 @@ static void on_device_routes(struct device *dev,
                                        &(size_t){route->n_profiles}, sizeof(int32_t), int32_cmp);
         if (!has_profile) {
             DEBUG("node %u dev %u routes: idx=%d dev=%d dir=%d act=%d: SKIP(profiles)",
-                  node->id, device_id(dev),
+                  node->id, node->device_id,
                   route->index, route->device, route->direction, route->active);
             continue;
         }
 
-        node->routes[node->n_routes] = (struct param_route){
-            .index = route->index,
-            .device = route->device,
-            .direction = route->direction,
-            .name = xstrdup(route->name),
-            .description = xstrdup(route->description),
-            .active = route->active,
-        };
-
         if (route->active) {
             DEBUG("node %u dev %u routes: idx=%d dev=%d dir=%d act=%d: VALID,ACTIVE",
-                  node->id, device_id(dev),
+                  node->id, node->device_id,
                   route->index, route->device, route->direction, route->active);
-
-            node->active_route = &node->routes[node->n_routes];
         } else {
             DEBUG("node %u dev %u routes: idx=%d dev=%d dir=%d act=%d: VALID",
-                  node->id, device_id(dev),
+                  node->id, node->device_id,
                   route->index, route->device, route->direction, route->active);
         }
 
-        node->n_routes += 1;
+        routes->items[n++] = (struct param_route){
+            .index = route->index,
+            .device = route->device,
+            .direction = route->direction,
+            .name = intern_ref(route->name),
+            .description = intern_ref(route->description),
+            .active = route->active,
+        };
+    }
+    routes->count = n;
+
+    if (n == all->count) {
+        /* every route belongs to this node, no need for a separate array */
+        param_routes_unref(&routes);
+        routes = param_routes_ref(all);
     }
 
-    if (!node->n_routes) {
-        WARN("node %u dev %u routes: no routes!", node->id, device_id(dev));
+    if (node->has_routes && param_routes_equal(routes, node->routes)) {
+        param_routes_unref(&routes);
+        return;
+    }
+
+    param_routes_unref(&node->routes);
+    node->routes = routes;
+
+    node->active_route = NULL;
+    for (unsigned i = 0; i < routes->count; i++) {
+        if (routes->items[i].active) {
+            node->active_route = &routes->items[i];
+            break;
+        }
+    }
+
+    if (!routes->count) {
+        WARN("node %u dev %u routes: no routes!", node->id, node->device_id);
     } else if (!node->active_route) {
-        WARN("node %u dev %u routes: no active!", node->id, device_id(dev));
+        WARN("node %u dev %u routes: no active!", node->id, node->device_id);
     }
 
     emit_routes(node, NULL);
     node->has_routes = true;
 }
 
-static void on_device_profiles(struct device *dev,
-                               const struct param_profile profiles[], unsigned profiles_count,
+static void on_device_routes(struct device *dev, const struct param_routes *routes, void *data) {
+    struct node *node = data;
+
+    DEBUG("node %u dev %u routes: count=%u", node->id, device_id(dev), routes->count);
+
+    param_routes_unref(&node->device_routes);
+    node->device_routes = param_routes_ref(routes);
+
+    update_routes(node);
+}
+
+static void on_device_profiles(struct device *dev, const struct param_profiles *profiles,
                                void *data) {
     struct node *node = data;
 
-    DEBUG("node %u dev %u profiles: count=%u", node->id, device_id(dev), profiles_count);
+    DEBUG("node %u dev %u profiles: count=%u", node->id, device_id(dev), profiles->count);
+
+    const int32_t old_device_profile = node->device_profile;
 
     node->device_profile = -1;
-    for (unsigned i = 0; i < profiles_count; i++) {
-        const struct param_profile *profile = &profiles[i];
+    for (unsigned i = 0; i < profiles->count; i++) {
+        const struct param_profile *profile = &profiles->items[i];
 
         DEBUG("node %u dev %u profiles: idx=%d act=%d",
               node->id, device_id(dev), profile->index, profile->active);
@@ -400,6 +519,12 @@ static void on_device_profiles(struct device *dev,
     if (node->device_profile < 0) {
         ERROR("node %u dev %u profiles: no active!", node->id, device_id(dev));
     }
+
+    /* device only sends routes when they change, but which of them belong
+     * to this node also depends on the active profile */
+    if (node->device_profile != old_device_profile && node->device_routes) {
+        update_routes(node);
+    }
 }
 
 static const struct device_events device_events = {
@@ -417,22 +542,35 @@ void on_node_info(void *data, const struct pw_node_info *info) {
         const bool first_props = !node->has_props;
         const struct spa_dict *props = info->props;
 
-        dict_clear(&node->props);
-        dict_reserve(&node->props, props->n_items);
-        for (unsigned i = 0; i < props->n_items; i++) {
-            const struct spa_dict_item *item = &props->items[i];
-            dict_insert(&node->props, item->key, item->value);
+        /* If no queued event holds the set anymore, everything in it was delivered.
+         * Otherwise keep adding to it, so that a coalesced event carries keys of
+         * all updates it replaced */
+        if (node->props_changes->refcnt == 1) {
+            dict_changes_clear(node->props_changes);
+        }
 
+        const size_t n_changes = node->props_changes->keys.size;
+        pipewire_props_assign(&node->props, props, &props_keys, node->props_changes);
+        const bool changed = node->props_changes->keys.size > n_changes;
+
+        /* default events are keyed by node.name, so the hook has to follow it.
+         * Values are interned, comparing pointers is enough */
+        const char *node_name = dict_get(&node->props, "node.name");
+        if (node->default_hook && node_name != node->default_hook_name) {
+            event_hook_release(node->default_hook);
+            node->default_hook = NULL;
+            intern_unref(node->default_hook_name);
+            node->default_hook_name = NULL;
         }
 
-        const char *node_name;
         const bool wants_default = !node->default_hook
                                    && (node->media_class == AUDIO_SINK
                                        || node->media_class == AUDIO_SOURCE)
-                                   && (node_name = dict_get(&node->props, "node.name"));
+                                   && node_name;
         if (wants_default) {
             /* now we can start checking for default */
-            node->default_hook = pipewire_add_listener(&pipewire_events, node);
+            node->default_hook = pipewire_add_default_listener(node_name, &pipewire_events, node);
+            node->default_hook_name = intern_ref(node_name);
         }
 
         const char *device;
@@ -463,7 +601,9 @@ void on_node_info(void *data, const struct pw_node_info *info) {
             }
         }
 
-        emit_props(node, NULL);
+        if (changed || first_props) {
+            emit_props(node, NULL);
+        }
         node->has_props = true;
     }
 }
@@ -554,6 +694,8 @@ static const struct pw_proxy_events proxy_events = {
 struct node *node_create(struct pw_node *pw_node, uint32_t id, enum media_class media_class) {
     struct node *node = xmalloc(sizeof(*node));
 
+    add_own_props_keys();
+
     *node = (struct node){
         .id = id,
         .pw_node = pw_node,
@@ -561,7 +703,8 @@ struct node *node_create(struct pw_node *pw_node, uint32_t id, enum media_class
         .refcnt = 1,
     };
 
-    node->emitter = event_emitter_create(node_event_dispatcher);
+    node->emitter = event_emitter_create(&node_emitter_type);
+    node->props_changes = dict_changes_create();
 
     pw_node_add_listener(node->pw_node, &node->listener, &node_events, node);
     pw_proxy_add_listener(node->pw_proxy, &node->proxy_listener, &proxy_events, node);
@@ -573,15 +716,14 @@ static void node_destroy(struct node *node) {
     pw_proxy_destroy(node->pw_proxy);
 
     dict_free(&node->props);
+    dict_changes_unref(&node->props_changes);
     param_props_free_contents(&node->param_props);
 
-    for (unsigned i = 0; i < node->n_routes; i++) {
-        struct param_route *route = &node->routes[i];
-        param_route_free_contents(route);
-    }
-    free(node->routes);
+    param_routes_unref(&node->routes);
+    param_routes_unref(&node->device_routes);
 
     event_hook_release(node->default_hook);
+    intern_unref(node->default_hook_name);
 
     event_emitter_release(node->emitter);
 
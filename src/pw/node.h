@@ -18,6 +18,10 @@ enum media_class {
 
 struct node;
 
+/* Props keys that are not asked for here (and not read by node.c itself) are dropped
+ * as soon as they arrive. Must be called before nodes are created */
+void node_keep_props_keys(const struct dict_keys *keys);
+
 struct node *node_create(struct pw_node *pw_node, uint32_t id, enum media_class media_class);
 
 struct node *node_ref(struct node *node);
@@ -33,12 +37,36 @@ void node_change_volume(const struct node *node, bool absolute, float volume, ui
 void node_set_route(const struct node *node, uint32_t route_index);
 void node_set_default(const struct node *node);
 
+/* Everything currently known about a node. Each group of fields is only valid if
+ * the corresponding has_ flag is set */
+struct node_snapshot {
+    bool has_props;
+    const struct dict *props;
+
+    bool has_routes;
+    const struct param_routes *routes;
+
+    bool has_param_props;
+    const char **channel_names;
+    const float *channel_volumes;
+    unsigned channel_count;
+    bool mute;
+
+    bool has_default;
+    bool is_default;
+};
+
 struct node_events {
+    /* Sent once to a new listener instead of separate props, routes, channels,
+     * volume, mute and default events. If NULL, those callbacks are called instead */
+    void (*snapshot)(struct node *node, const struct node_snapshot *snapshot, void *data);
     void (*removed)(struct node *node, void *data);
-    void (*routes)(struct node *node,
-                   const struct param_route routes[], unsigned routes_count,
-                   void *data);
-    void (*props)(struct node *node, const struct dict *props, void *data);
+    /* see device_events.routes */
+    void (*routes)(struct node *node, const struct param_routes *routes, void *data);
+    /* changed is the set of keys that were added, removed or modified since the previous
+     * props event, NULL if all of them should be considered changed */
+    void (*props)(struct node *node, const struct dict *props,
+                  const struct dict_changes *changed, void *data);
     void (*channels)(struct node *node,
                      const char *channel_names[], unsigned channel_count,
                      void *data);
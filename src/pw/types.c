@@ -1,6 +1,10 @@
 #include <stdlib.h>
+#include <string.h>
 
 #include "pw/types.h"
+#include "collections/intern.h"
+#include "xmalloc.h"
+#include "log.h"
 
 void param_props_free_contents(struct param_props *props) {
     if (props) {
@@ -11,17 +15,130 @@ void param_props_free_contents(struct param_props *props) {
 
 void param_route_free_contents(struct param_route *route) {
     if (route) {
-        free(route->description);
-        free(route->name);
+        intern_unref(route->description);
+        intern_unref(route->name);
         free(route->devices);
         free(route->profiles);
     }
 }
 
+static bool int_arrays_equal(const pw_int_t *a, unsigned a_len,
+                             const pw_int_t *b, unsigned b_len) {
+    return a_len == b_len && (a_len == 0 || memcmp(a, b, a_len * sizeof(a[0])) == 0);
+}
+
+/* strings are interned, so comparing pointers is enough */
+static bool param_route_equal(const struct param_route *a, const struct param_route *b) {
+    return a->index == b->index
+        && a->device == b->device
+        && a->direction == b->direction
+        && a->active == b->active
+        && a->name == b->name
+        && a->description == b->description
+        && int_arrays_equal(a->devices, a->n_devices, b->devices, b->n_devices)
+        && int_arrays_equal(a->profiles, a->n_profiles, b->profiles, b->n_profiles);
+}
+
+struct param_routes *param_routes_create(unsigned capacity) {
+    struct param_routes *routes = xzalloc(sizeof(*routes) + capacity * sizeof(routes->items[0]));
+    routes->refcnt = 1;
+    routes->count = capacity;
+
+    return routes;
+}
+
+struct param_routes *param_routes_ref(const struct param_routes *routes) {
+    /* refcount is not part of the contents */
+    struct param_routes *mut = (struct param_routes *)routes;
+    ASSERT(mut->refcnt > 0);
+    mut->refcnt += 1;
+
+    return mut;
+}
+
+void param_routes_unref(struct param_routes **proutes) {
+    struct param_routes *routes = *proutes;
+
+    if (routes && --routes->refcnt == 0) {
+        for (unsigned i = 0; i < routes->count; i++) {
+            param_route_free_contents(&routes->items[i]);
+        }
+        free(routes);
+    }
+    *proutes = NULL;
+}
+
+bool param_routes_equal(const struct param_routes *a, const struct param_routes *b) {
+    if (a == b) {
+        return true;
+    } else if (!a || !b || a->count != b->count) {
+        return false;
+    }
+
+    for (unsigned i = 0; i < a->count; i++) {
+        if (!param_route_equal(&a->items[i], &b->items[i])) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
 void param_profile_free_contents(struct param_profile *profile) {
     if (profile) {
-        free(profile->name);
-        free(profile->description);
+        intern_unref(profile->name);
+        intern_unref(profile->description);
+    }
+}
+
+static bool param_profile_equal(const struct param_profile *a, const struct param_profile *b) {
+    return a->index == b->index
+        && a->active == b->active
+        && a->name == b->name
+        && a->description == b->description;
+}
+
+struct param_profiles *param_profiles_create(unsigned capacity) {
+    struct param_profiles *profiles =
+        xzalloc(sizeof(*profiles) + capacity * sizeof(profiles->items[0]));
+    profiles->refcnt = 1;
+    profiles->count = capacity;
+
+    return profiles;
+}
+
+struct param_profiles *param_profiles_ref(const struct param_profiles *profiles) {
+    struct param_profiles *mut = (struct param_profiles *)profiles;
+    ASSERT(mut->refcnt > 0);
+    mut->refcnt += 1;
+
+    return mut;
+}
+
+void param_profiles_unref(struct param_profiles **pprofiles) {
+    struct param_profiles *profiles = *pprofiles;
+
+    if (profiles && --profiles->refcnt == 0) {
+        for (unsigned i = 0; i < profiles->count; i++) {
+            param_profile_free_contents(&profiles->items[i]);
+        }
+        free(profiles);
     }
+    *pprofiles = NULL;
 }
 
+bool param_profiles_equal(const struct param_profiles *a, const struct param_profiles *b) {
+    if (a == b) {
+        return true;
+    } else if (!a || !b || a->count != b->count) {
+        return false;
+    }
+
+    for (unsigned i = 0; i < a->count; i++) {
+        if (!param_profile_equal(&a->items[i], &b->items[i])) {
+            return false;
+        }
+    }
+
+    return true;
+}
@@ -26,22 +26,54 @@ struct param_route {
     unsigned n_devices;
     unsigned n_profiles;
 
-    char *description;
-    char *name;
+    /* interned, see collections/intern.h */
+    const char *description;
+    const char *name;
 
     bool active;
 };
 
 void param_route_free_contents(struct param_route *route);
 
+/*
+ * Routes and profiles are passed around as immutable refcounted arrays. An array is
+ * never modified after it's published, any change produces a new one. This way the same
+ * array can be held by a device, its nodes and their listeners without copying.
+ */
+struct param_routes {
+    unsigned refcnt;
+    unsigned count;
+    struct param_route items[];
+};
+
+/* items are zeroed, count is set to capacity and can be lowered before publishing */
+struct param_routes *param_routes_create(unsigned capacity);
+struct param_routes *param_routes_ref(const struct param_routes *routes);
+void param_routes_unref(struct param_routes **proutes);
+/* true if both have the same routes in the same order, either can be NULL */
+bool param_routes_equal(const struct param_routes *a, const struct param_routes *b);
+
 struct param_profile {
     pw_int_t index;
 
-    char *description;
-    char *name;
+    /* interned */
+    const char *description;
+    const char *name;
 
     bool active;
 };
 
 void param_profile_free_contents(struct param_profile *profile);
 
+/* see struct param_routes */
+struct param_profiles {
+    unsigned refcnt;
+    unsigned count;
+    struct param_profile items[];
+};
+
+struct param_profiles *param_profiles_create(unsigned capacity);
+struct param_profiles *param_profiles_ref(const struct param_profiles *profiles);
+void param_profiles_unref(struct param_profiles **pprofiles);
+bool param_profiles_equal(const struct param_profiles *a, const struct param_profiles *b);
+
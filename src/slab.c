@@ -0,0 +1,55 @@
+#include <stdalign.h>
+#include <stddef.h>
+
+#include "slab.h"
+#include "xmalloc.h"
+#include "macros.h"
+#include "log.h"
+
+/* every object is at least big enough to hold a free list link and suitably aligned */
+static size_t object_stride(const struct slab_pool *pool) {
+    const size_t align = alignof(max_align_t);
+    const size_t size = MAX(pool->obj_size, sizeof(void *));
+    return (size + align - 1) / align * align;
+}
+
+static void slab_grow(struct slab_pool *pool) {
+    const size_t stride = object_stride(pool);
+    unsigned char *slab = xcalloc(pool->objs_per_slab, stride);
+
+    /* thread new objects onto free list, first object ends up on top */
+    for (size_t i = pool->objs_per_slab; i-- > 0; ) {
+        void *obj = &slab[i * stride];
+        *(void **)obj = pool->free_list;
+        pool->free_list = obj;
+    }
+
+    pool->capacity += pool->objs_per_slab;
+    DEBUG("slab: pool %s grown to %zu objects", pool->name, pool->capacity);
+}
+
+void *slab_alloc(struct slab_pool *pool) {
+    if (pool->free_list == NULL) {
+        slab_grow(pool);
+    }
+
+    void *obj = pool->free_list;
+    pool->free_list = *(void **)obj;
+
+    pool->in_use += 1;
+    pool->high_water = MAX(pool->high_water, pool->in_use);
+
+    return obj;
+}
+
+void slab_free(struct slab_pool *pool, void *obj) {
+    if (obj == NULL) {
+        return;
+    }
+
+    ASSERT(pool->in_use > 0);
+
+    *(void **)obj = pool->free_list;
+    pool->free_list = obj;
+    pool->in_use -= 1;
+}
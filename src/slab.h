@@ -0,0 +1,25 @@
+#pragma once
+
+#include <stddef.h>
+
+/*
+ * Pool of fixed-size objects carved out of larger slabs. Freed objects go to
+ * a free list and are handed out again before any new slab is allocated.
+ * Slabs are never returned to the system.
+ */
+struct slab_pool {
+    const char *name;
+    size_t obj_size;
+    size_t objs_per_slab;
+
+    void *free_list;
+
+    /* objects currently handed out, most at the same time, allocated in total */
+    size_t in_use, high_water, capacity;
+};
+
+#define SLAB_POOL_INIT(type, n) { .name = #type, .obj_size = sizeof(type), .objs_per_slab = (n) }
+
+/* aborts on alloc fail, memory is not initialised */
+void *slab_alloc(struct slab_pool *pool);
+void slab_free(struct slab_pool *pool, void *obj);
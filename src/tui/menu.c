@@ -81,13 +81,13 @@ void tui_menu_draw(const struct tui_menu *const menu) {
         waddwstr(win, config.borders.rs);
     }
 
-    mvwaddnwstr(win, 0, 1, menu->header.data, menu->w - 2);
+    mvwaddnwstr(win, 0, 1, wstring_data(&menu->header), menu->w - 2);
     for (unsigned int i = 0; i < menu->n_items; i++) {
         if (i == menu->selected) {
             wattron(win, A_BOLD);
         }
 
-        mvwaddnwstr(win, 1 + i, 1, menu->items[i].wstr.data, menu->w - 2);
+        mvwaddnwstr(win, 1 + i, 1, wstring_data(&menu->items[i].wstr), menu->w - 2);
 
         wattroff(win, A_BOLD);
     }
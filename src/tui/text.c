@@ -0,0 +1,234 @@
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+#include <wchar.h>
+
+#include "tui/text.h"
+#include "xmalloc.h"
+#include "macros.h"
+
+static const wchar_t ellipsis[] = L"…";
+
+void tui_text_init(struct tui_text *text) {
+    *text = (struct tui_text){0};
+    string_init(&text->str);
+}
+
+void tui_text_free(struct tui_text *text) {
+    string_free(&text->str);
+    free(text->offs);
+    free(text->cols);
+    tui_text_init(text);
+}
+
+void tui_text_clear(struct tui_text *text) {
+    string_clear(&text->str);
+    text->borrowed = NULL;
+    tui_text_changed(text);
+}
+
+int tui_text_printf(struct tui_text *text, const char *fmt, ...) {
+    if (text->borrowed) {
+        /* continue from the borrowed text, now as our own copy */
+        string_appendsn(&text->str, text->borrowed, text->borrowed_len);
+        text->borrowed = NULL;
+    }
+
+    va_list args;
+    va_start(args, fmt);
+    const int len = string_vprintf(&text->str, fmt, args);
+    va_end(args);
+
+    tui_text_changed(text);
+
+    return len;
+}
+
+void tui_text_borrow(struct tui_text *text, const char *s) {
+    string_clear(&text->str);
+    text->borrowed = s;
+    text->borrowed_len = strlen(s);
+    tui_text_changed(text);
+}
+
+const char *tui_text_data(const struct tui_text *text) {
+    return text->borrowed ? text->borrowed : string_data(&text->str);
+}
+
+static size_t text_len(const struct tui_text *text) {
+    return text->borrowed ? text->borrowed_len : text->str.len;
+}
+
+/* Decodes one character of at most len bytes. Invalid sequences are consumed one byte
+ * at a time and shown as U+FFFD */
+static size_t decode(const char *s, size_t len, wchar_t *wc) {
+    const size_t ret = mbrtowc(wc, s, len, &(mbstate_t){0});
+    if (ret == 0) {
+        /* embedded null */
+        return 1;
+    } else if (ret == (size_t)-1 || ret == (size_t)-2) {
+        *wc = L'�';
+        return 1;
+    }
+    return ret;
+}
+
+void tui_text_changed(struct tui_text *text) {
+    text->indexed = false;
+}
+
+static void build_index(struct tui_text *text) {
+    if (text->indexed) {
+        return;
+    }
+    text->indexed = true;
+
+    const char *const s = tui_text_data(text);
+    const size_t len = text_len(text);
+
+    /* no early exit on purpose, this way the compiler can vectorize the loop */
+    bool ascii = true;
+    for (size_t i = 0; i < len; i++) {
+        ascii &= (s[i] >= 0x20 && s[i] < 0x7F);
+    }
+    text->non_ascii = !ascii;
+
+    if (!text->non_ascii) {
+        text->n_chars = len;
+        return;
+    }
+
+    /* there are at most as many characters as bytes */
+    if (text->index_cap < len + 1) {
+        text->index_cap = len + 1;
+        text->offs = xreallocarray(text->offs, text->index_cap, sizeof(text->offs[0]));
+        text->cols = xreallocarray(text->cols, text->index_cap, sizeof(text->cols[0]));
+    }
+
+    size_t n = 0, off = 0;
+    text->offs[0] = 0;
+    text->cols[0] = 0;
+    while (off < len) {
+        wchar_t wc;
+        off += decode(&s[off], len - off, &wc);
+
+        text->offs[n + 1] = off;
+        text->cols[n + 1] = text->cols[n] + MAX(0, wcwidth(wc));
+        n += 1;
+    }
+    text->n_chars = n;
+}
+
+/* width of first n characters */
+static int prefix_columns(const struct tui_text *text, size_t n) {
+    return text->non_ascii ? text->cols[n] : (int)n;
+}
+
+/* largest number of leading characters that fit in columns */
+static size_t prefix_fitting(const struct tui_text *text, int columns) {
+    if (!text->non_ascii) {
+        return MIN(text->n_chars, (size_t)MAX(columns, 0));
+    }
+
+    /* find last n such that cols[n] <= columns, cols[0] is always 0 */
+    size_t lo = 0, hi = text->n_chars;
+    while (lo < hi) {
+        const size_t mid = lo + (hi - lo + 1) / 2;
+        if (text->cols[mid] <= columns) {
+            lo = mid;
+        } else {
+            hi = mid - 1;
+        }
+    }
+
+    return lo;
+}
+
+/* prints first n characters, converting only those */
+static void print_prefix(WINDOW *win, const struct tui_text *text, size_t n) {
+    const char *const s = tui_text_data(text);
+
+    if (!text->non_ascii) {
+        waddnstr(win, s, n);
+        return;
+    }
+
+    wchar_t buf[256];
+    size_t buf_len = 0;
+    for (size_t i = 0; i < n; i++) {
+        decode(&s[text->offs[i]], text->offs[i + 1] - text->offs[i], &buf[buf_len++]);
+        if (buf_len == SIZEOF_ARRAY(buf)) {
+            waddnwstr(win, buf, buf_len);
+            buf_len = 0;
+        }
+    }
+    if (buf_len > 0) {
+        waddnwstr(win, buf, buf_len);
+    }
+}
+
+int tui_text_columns(struct tui_text *text) {
+    build_index(text);
+    return prefix_columns(text, text->n_chars);
+}
+
+int tui_text_print(WINDOW *win, int y, int x, struct tui_text *text, int max_columns) {
+    if (max_columns <= 0) {
+        return 0;
+    }
+
+    /* text that doesn't fit on screen never gets here, so is never indexed */
+    build_index(text);
+    if (text->n_chars == 0 || wmove(win, y, x) != OK) {
+        return 0;
+    }
+
+    const int total = prefix_columns(text, text->n_chars);
+    if (total <= max_columns) {
+        print_prefix(win, text, text->n_chars);
+        return total;
+    }
+
+    /* leave one column for ellipsis */
+    const size_t n = prefix_fitting(text, max_columns - 1);
+    if (n > 0) {
+        print_prefix(win, text, n);
+    }
+    waddnwstr(win, ellipsis, 1);
+
+    return prefix_columns(text, n) + 1;
+}
+
+int tui_print_with_ellipsis(WINDOW *win, int y, int x,
+                            const wchar_t string[], int string_len, int max_columns) {
+    if (max_columns <= 0 || string_len <= 0 || wmove(win, y, x) != OK) {
+        return 0;
+    }
+
+    int n = 0, columns = 0;
+    for (; n < string_len; n++) {
+        const int width = MAX(0, wcwidth(string[n]));
+        if (columns + width > max_columns) {
+            break;
+        }
+        columns += width;
+    }
+
+    if (n == string_len) {
+        waddnwstr(win, string, n);
+        return columns;
+    }
+
+    /* does not fit, back off until there is space for ellipsis */
+    while (n > 0 && columns > max_columns - 1) {
+        n -= 1;
+        columns -= MAX(0, wcwidth(string[n]));
+    }
+
+    if (n > 0) {
+        waddnwstr(win, string, n);
+    }
+    waddnwstr(win, ellipsis, 1);
+
+    return columns + 1;
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdbool.h>
+#include <wchar.h>
+
+#include <ncurses.h>
+
+#include "collections/string.h"
+
+/*
+ * A UTF-8 string that knows how many columns each of its prefixes takes on screen,
+ * so it can be truncated to fit without calling wcwidth() on every draw. Only the
+ * part that is actually drawn is converted to wide characters.
+ * The index is built on first draw after tui_text_changed(), which must be called
+ * after modifying str directly (tui_text_* functions do it themselves).
+ */
+struct tui_text {
+    struct string str;
+    /* if not NULL, text is this string instead of str, see tui_text_borrow() */
+    const char *borrowed;
+    size_t borrowed_len;
+
+    /* everything below is up to date */
+    bool indexed;
+    /* some characters are not printable ascii, otherwise every byte is one character
+     * that takes one column, and nothing below is needed */
+    bool non_ascii;
+    /* only valid if non_ascii, both have n_chars + 1 entries:
+     * offs[i] is byte offset of character i, cols[i] is width of first i characters */
+    size_t n_chars;
+    unsigned *offs;
+    int *cols;
+    size_t index_cap;
+};
+
+void tui_text_init(struct tui_text *text);
+void tui_text_free(struct tui_text *text);
+
+void tui_text_clear(struct tui_text *text);
+int tui_text_printf(struct tui_text *text, const char *fmt, ...);
+/* Shows s without copying it. s must stay valid and unchanged until text is
+ * cleared, borrows another string or is freed */
+void tui_text_borrow(struct tui_text *text, const char *s);
+void tui_text_changed(struct tui_text *text);
+/* either str or the borrowed string */
+const char *tui_text_data(const struct tui_text *text);
+
+int tui_text_columns(struct tui_text *text);
+
+/* Prints at most max_columns columns of text at y, x, replacing the tail with "…"
+ * if it does not fit. Returns number of columns printed */
+int tui_text_print(WINDOW *win, int y, int x, struct tui_text *text, int max_columns);
+
+/* Same as tui_text_print() but for strings that are not drawn often enough to be cached */
+int tui_print_with_ellipsis(WINDOW *win, int y, int x,
+                            const wchar_t string[], int string_len, int max_columns);
+
@@ -8,6 +8,7 @@
 
 #include "tui/tui.h"
 #include "tui/pad.h"
+#include "tui/text.h"
 #include "macros.h"
 #include "log.h"
 #include "xmalloc.h"
@@ -19,6 +20,9 @@
 
 #define FOR_EACH_TAB(var) for (int var = 0; var < tui.tabs_count; var++)
 
+/* how many tabs keep their pads around while not shown */
+#define TUI_MAX_CACHED_TABS 3
+
 enum color_pair {
     DEFAULT = 0,
     GREEN = 1,
@@ -60,13 +64,34 @@ static int find_tab(enum tui_tab_type type) {
 }
 
 static void trigger_update(void) {
-    if (!tui.update_triggered) {
-        if (pw_loop_signal_event(event_loop, tui.update_source) < 0) {
-            ERROR("failed to trigger ui update");
-        } else {
-            tui.update_triggered = true;
+    if (tui.update_triggered) {
+        return;
+    }
+
+    if (config.max_fps > 0) {
+        const uint64_t frame_interval = SPA_NSEC_PER_SEC / config.max_fps;
+        const uint64_t next_frame = tui.last_frame + frame_interval;
+
+        if (monotonic_time_ns() < next_frame) {
+            /* too early, delay until next frame is due */
+            struct timespec when = {
+                .tv_sec = next_frame / SPA_NSEC_PER_SEC,
+                .tv_nsec = next_frame % SPA_NSEC_PER_SEC,
+            };
+            if (pw_loop_update_timer(event_loop, tui.update_timer, &when, NULL, true) < 0) {
+                ERROR("failed to schedule ui update");
+            } else {
+                tui.update_triggered = true;
+            }
+            return;
         }
     }
+
+    if (pw_loop_signal_event(event_loop, tui.update_source) < 0) {
+        ERROR("failed to trigger ui update");
+    } else {
+        tui.update_triggered = true;
+    }
 }
 
 static void trigger_resize(void) {
@@ -79,65 +104,162 @@ static void trigger_resize(void) {
     }
 }
 
-static int print_with_ellipsis(WINDOW *win, int y, int x,
-                               const wchar_t string[], int string_len,
-                               int max_columns) {
-    if (max_columns <= 0 || string_len <= 0 || wmove(win, y, x) != OK) {
-        return 0;
+static int tui_tab_item_pos(const struct tui_tab_item *const item) {
+    return sumtree_offset(&item->layout);
+}
+
+static int tui_tab_item_height(const struct tui_tab_item *const item) {
+    return item->layout.weight;
+}
+
+/* height of the tab area, which is also the height of every tab pad */
+static int view_height(void) {
+    return MAX(tui.term_height - 1, 1);
+}
+
+/* Returns row of tab pad where top line of item should be drawn.
+ * Might be negative or past the end of pad if item is (partially) scrolled out of view */
+static int tui_tab_item_top(const struct tui_tab_item *const item) {
+    return tui_tab_item_pos(item) - tui.tabs[item->tab_index].scroll_pos;
+}
+
+/* Returns row of tab pad where given line of item with given top should be drawn,
+ * or -1 if that line is currently scrolled out of view */
+static int view_row(int top, int line) {
+    const int row = top + line;
+    return (row >= 0 && row < view_height()) ? row : -1;
+}
+
+/* Computes everything about item layout that does not depend on the item itself.
+ * Must be called whenever term_width changes */
+static void update_geometry(void) {
+    struct tui_geometry *g = &tui.geometry;
+
+    g->usable_width = tui.term_width - 2; /* account for box borders */
+    const int two_thirds_usable_width = g->usable_width / 3 * 2;
+    /* 5 for channel name, 1 space, 3 volume, 1 space, 4 more for decorations = 14 */
+    const int volume_bar_width_max = two_thirds_usable_width - 14;
+    g->volume_bar_width = (volume_bar_width_max / 15) * 15;
+    const int volume_area_width = g->volume_bar_width + 14;
+    const int info_area_width = g->usable_width - volume_area_width - 1; /* leave a space */
+    g->info_area_start = 1; /* right after box border */
+    g->volume_area_start = g->info_area_start + info_area_width + 1;
+    g->volume_bar_start = g->volume_area_start + 12; /* minus two decorations at the end */
+
+    wstring_clear(&g->border_top);
+    wstring_clear(&g->border_bottom);
+    wstring_clear(&g->blanks);
+
+    wstring_appendwsz(&g->border_top, config.borders.tl);
+    wstring_appendwsz(&g->border_bottom, config.borders.bl);
+    for (int x = 1; x < tui.term_width - 1; x++) {
+        wstring_appendwsz(&g->border_top, config.borders.ts);
+        wstring_appendwsz(&g->border_bottom, config.borders.bs);
+    }
+    wstring_appendwsz(&g->border_top, config.borders.tr);
+    wstring_appendwsz(&g->border_bottom, config.borders.br);
+
+    for (int x = 0; x < g->usable_width; x++) {
+        wstring_appendwc(&g->blanks, L' ');
+    }
+}
+
+/* pads the rest of usable area after cols printed columns with spaces */
+static void fill_blanks(WINDOW *win, int cols) {
+    if (cols < tui.geometry.usable_width) {
+        waddnwstr(win, wstring_data(&tui.geometry.blanks), tui.geometry.usable_width - cols);
     }
+}
 
-    int columns = 0;
-    for (int i = 0; i < string_len; i++) {
-        const wchar_t wc[2] = { string[i], L'\0' };
-        const int width = MAX(0, wcwidth(wc[0]));
+static void tui_tab_item_draw_borders(WINDOW *win, int top, int height) {
+    int pos = view_row(top, 0);
+    if (pos >= 0) {
+        mvwaddwstr(win, pos, 0, wstring_data(&tui.geometry.border_top));
+    }
 
-        const bool truncate = (i < string_len - 1 && columns + width >= max_columns)
-                           || (i == string_len - 1 && columns + width > max_columns);
+    pos = view_row(top, height - 1);
+    if (pos >= 0) {
+        mvwaddwstr(win, pos, 0, wstring_data(&tui.geometry.border_bottom));
+    }
 
-        cchar_t cc;
-        if (!truncate) {
-            setcchar(&cc, wc, 0, 0, NULL);
-            wadd_wch(win, &cc);
-            columns += width;
-        } else {
-            setcchar(&cc, L"…", 0, 0, NULL);
-            wadd_wch(win, &cc);
-            columns += 1;
-            break;
+    for (int y = 1; y < height - 1; y++) {
+        pos = view_row(top, y);
+        if (pos < 0) {
+            continue;
+        }
+        wmove(win, pos, 0);
+        waddwstr(win, config.borders.ls);
+        wmove(win, pos, tui.term_width - 1);
+        waddwstr(win, config.borders.ls);
+    }
+}
+
+enum bar_variant {
+    BAR_MUTED = 1 << 0,
+    BAR_FOCUSED = 1 << 1,
+
+    BAR_VARIANT_COUNT = 1 << 2,
+};
+
+/* Returns a row of width volume bar cells, either all full or all empty, for given variant.
+ * Rows are rebuilt only when width changes. Attributes are baked into cells
+ * because wadd_wchnstr() ignores window attributes */
+static const cchar_t *bar_cells(int width, enum bar_variant variant, bool full) {
+    if (tui.bar_cells_width != width) {
+        tui.bar_cells = xreallocarray(tui.bar_cells,
+                                      BAR_VARIANT_COUNT * 2 * width, sizeof(tui.bar_cells[0]));
+        tui.bar_cells_width = width;
+
+        const int step = width / 3;
+        for (unsigned v = 0; v < BAR_VARIANT_COUNT; v++) {
+            const attr_t attrs = ((v & BAR_MUTED) ? A_DIM : 0) | ((v & BAR_FOCUSED) ? A_BOLD : 0);
+            for (int f = 0; f <= 1; f++) {
+                cchar_t *row = &tui.bar_cells[(v * 2 + f) * width];
+                int pair = DEFAULT;
+                for (int j = 0; j < width; j++) {
+                    if (j % step == 0 && !(v & BAR_MUTED)) {
+                        pair += 1;
+                    }
+                    setcchar(&row[j], f ? config.bar_full_char : config.bar_empty_char,
+                             attrs, pair, NULL);
+                }
+            }
         }
     }
 
-    return columns;
+    return &tui.bar_cells[(variant * 2 + full) * width];
 }
 
-static void tui_tab_item_draw_node(const struct tui_tab_item *const item,
+static void tui_tab_item_draw_node(struct tui_tab_item *const item,
                                    enum tui_tab_item_draw_mask mask) {
     #define DRAW(element) if (mask & TUI_TAB_ITEM_DRAW_##element)
 
-    const struct tui_tab_item_node_data *d = &item->as.node;
+    struct tui_tab_item_node_data *d = &item->as.node;
 
-    const int usable_width = tui.term_width - 2; /* account for box borders */
-    const int two_thirds_usable_width = usable_width / 3 * 2;
-    /* 5 for channel name, 1 space, 3 volume, 1 space, 4 more for decorations = 14 */
-    const int volume_bar_width_max = two_thirds_usable_width - 14;
-    const int volume_bar_width = (volume_bar_width_max / 15) * 15;
-    const int volume_area_width = volume_bar_width + 14;
-    const int info_area_width = usable_width - volume_area_width - 1; /* leave a space */
-    const int info_area_start = 1; /* right after box border */
-    const int volume_area_start = info_area_start + info_area_width + 1;
-    const int volume_bar_start = volume_area_start + 12; /* minus two decorations at the end */
+    const int usable_width = tui.geometry.usable_width;
+    const int volume_bar_width = tui.geometry.volume_bar_width;
+    const int info_area_start = tui.geometry.info_area_start;
+    const int volume_area_start = tui.geometry.volume_area_start;
+    const int volume_bar_start = tui.geometry.volume_bar_start;
 
     const bool focused = item->focused;
     const bool muted = d->muted;
 
+    const int top = tui_tab_item_top(item);
+    const int height = tui_tab_item_height(item);
+
     TRACE("tui_draw_node: id %d mask %x", d->id, mask);
 
-    WINDOW *const win = tui.pad_win;
+    WINDOW *const win = tui.tabs[item->tab_index].win;
 
     /* prevents leftover artifacts */
     DRAW(BLANKS) {
-        for (int i = 0; i < item->height; i++) {
-            wmove(win, item->pos + i, 0);
+        for (int i = 0; i < height; i++) {
+            const int pos = view_row(top, i);
+            if (pos < 0) {
+                continue;
+            }
+            wmove(win, pos, 0);
             wclrtoeol(win);
         }
     }
@@ -147,46 +269,70 @@ static void tui_tab_item_draw_node(const struct tui_tab_item *const item,
     }
 
     DRAW(DESCRIPTION) {
+        const int pos = view_row(top, 1);
+        if (pos < 0) {
+            goto description_end;
+        }
+
         int cols = 0;
         if (d->is_default) {
-            cols += print_with_ellipsis(win, item->pos + 1, info_area_start,
-                                        L"[*] ", wcslen(L"[*] "), usable_width);
+            cols += tui_print_with_ellipsis(win, pos, info_area_start,
+                                            L"[*] ", wcslen(L"[*] "), usable_width);
         }
-        cols += print_with_ellipsis(win, item->pos + 1, info_area_start + cols,
-                                    d->info.data, d->info.len, usable_width - cols);
+        cols += tui_text_print(win, pos, info_area_start + cols,
+                               &d->info, usable_width - cols);
 
-        for (int i = cols; i < usable_width; i++) {
-            waddch(win, ' ');
-        }
+        fill_blanks(win, cols);
     }
+description_end:
 
     DRAW(CHANNELS) {
         if (muted) {
             wattron(win, A_DIM);
         }
 
+        const enum bar_variant variant = (muted ? BAR_MUTED : 0) | (focused ? BAR_FOCUSED : 0);
+        /* after BLANKS the bars are gone, otherwise only cells that changed are drawn */
+        const bool full_redraw = (mask & TUI_TAB_ITEM_DRAW_BLANKS)
+                              || variant != d->drawn_bar_variant;
+        d->drawn_bar_variant = variant;
+
         for (unsigned i = 0; i < d->n_channels; i++) {
-            const struct channel_info *c = &d->channels[i];
+            struct channel_info *c = &d->channels[i];
 
-            const int pos = item->pos + i + 2;
+            const int pos = view_row(top, i + 2);
+            if (pos < 0) {
+                continue;
+            }
 
             const int vol_int = (int)roundf(c->volume * 100);
 
             mvwprintw(win, pos, volume_area_start, "%5s %-3d ", c->name, vol_int);
 
+            if (volume_bar_width <= 0) {
+                continue;
+            }
+
             /* draw volume bar */
-            int pair = DEFAULT;
-            const int step = volume_bar_width / 3;
-            const int thresh = vol_int * volume_bar_width / 150;
-            for (int j = 0; j < volume_bar_width; j++) {
-                cchar_t cc;
-                if (j % step == 0 && !muted) {
-                    pair += 1;
+            const cchar_t *full_cells = bar_cells(volume_bar_width, variant, true);
+            const cchar_t *empty_cells = bar_cells(volume_bar_width, variant, false);
+            const int fill = MIN(MAX(vol_int * volume_bar_width / 150, 0), volume_bar_width);
+            if (full_redraw) {
+                if (fill > 0) {
+                    mvwadd_wchnstr(win, pos, volume_bar_start, full_cells, fill);
+                }
+                if (fill < volume_bar_width) {
+                    mvwadd_wchnstr(win, pos, volume_bar_start + fill,
+                                   &empty_cells[fill], volume_bar_width - fill);
                 }
-                setcchar(&cc, (j < thresh) ? config.bar_full_char : config.bar_empty_char,
-                         0, pair, NULL);
-                mvwadd_wch(win, pos, volume_bar_start + j, &cc);
+            } else if (fill > c->drawn_fill) {
+                mvwadd_wchnstr(win, pos, volume_bar_start + c->drawn_fill,
+                               &full_cells[c->drawn_fill], fill - c->drawn_fill);
+            } else if (fill < c->drawn_fill) {
+                mvwadd_wchnstr(win, pos, volume_bar_start + fill,
+                               &empty_cells[fill], c->drawn_fill - fill);
             }
+            c->drawn_fill = fill;
         }
 
         wattroff(win, A_DIM);
@@ -198,7 +344,10 @@ static void tui_tab_item_draw_node(const struct tui_tab_item *const item,
         }
 
         for (unsigned i = 0; i < d->n_channels; i++) {
-            const int pos = item->pos + i + 2;
+            const int pos = view_row(top, i + 2);
+            if (pos < 0) {
+                continue;
+            }
 
             const wchar_t *wchar_left, *wchar_right;
             cchar_t cchar_left, cchar_right;
@@ -238,48 +387,44 @@ static void tui_tab_item_draw_node(const struct tui_tab_item *const item,
     }
 
     DRAW(ROUTES) {
-        if (!d->n_routes) {
+        const int routes_line_pos = view_row(top, height - 2);
+        if (!d->n_routes || routes_line_pos < 0) {
             goto routes_end;
         }
 
-        const int routes_line_pos = item->pos + item->height - 2;
-
         int cols = 0;
-        cols += print_with_ellipsis(win, routes_line_pos, 1,
-                                    L"Routes: ", wcslen(L"Routes: "),
-                                    usable_width);
+        cols += tui_print_with_ellipsis(win, routes_line_pos, 1,
+                                        L"Routes: ", wcslen(L"Routes: "),
+                                        usable_width);
 
         if (!d->n_routes) {
             wattron(win, A_DIM);
-            cols += print_with_ellipsis(win, routes_line_pos, 1 + cols,
-                                        L"(none)", wcslen(L"(none)"),
-                                        usable_width - cols);
+            cols += tui_print_with_ellipsis(win, routes_line_pos, 1 + cols,
+                                            L"(none)", wcslen(L"(none)"),
+                                            usable_width - cols);
         } else {
             if (d->active_route) {
                 /* draw active route first */
-                cols += print_with_ellipsis(win, routes_line_pos, 1 + cols,
-                                            d->active_route->description.data,
-                                            d->active_route->description.len,
-                                            usable_width - cols);
+                cols += tui_text_print(win, routes_line_pos, 1 + cols,
+                                       &d->active_route->description, usable_width - cols);
             }
 
             wattron(win, A_DIM);
             for (unsigned i = 0; i < d->n_routes; i++) {
-                const struct route_info *p = &d->routes[i];
+                struct route_info *p = &d->routes[i];
                 if (p == d->active_route) {
                     continue;
                 }
 
                 if (i > 0 || d->active_route) {
-                    cols += print_with_ellipsis(win, routes_line_pos, 1 + cols,
-                                                config.routes_separator,
-                                                wcslen(config.routes_separator),
-                                                usable_width - cols);
+                    cols += tui_print_with_ellipsis(win, routes_line_pos, 1 + cols,
+                                                    config.routes_separator,
+                                                    wcslen(config.routes_separator),
+                                                    usable_width - cols);
                 }
 
-                cols += print_with_ellipsis(win, routes_line_pos, 1 + cols,
-                                            p->description.data, p->description.len,
-                                            usable_width - cols);
+                cols += tui_text_print(win, routes_line_pos, 1 + cols,
+                                       &p->description, usable_width - cols);
             }
         }
 
@@ -288,30 +433,7 @@ static void tui_tab_item_draw_node(const struct tui_tab_item *const item,
 routes_end:
 
     DRAW(BORDERS) {
-        /* box */
-        wmove(win, item->pos, 0);
-        waddwstr(win, config.borders.tl);
-        for (int x = 1; x < tui.term_width - 1; x++) {
-            waddwstr(win, config.borders.ts);
-        }
-        waddwstr(win, config.borders.tr);
-
-        wmove(win, item->pos + item->height - 1, 0);
-        waddwstr(win, config.borders.bl);
-        for (int x = 1; x < tui.term_width - 1; x++) {
-            waddwstr(win, config.borders.bs);
-        }
-        waddwstr(win, config.borders.br);
-
-        for (int y = 1; y < item->height - 1; y++) {
-            wmove(win, item->pos + y, 0);
-            waddwstr(win, config.borders.ls);
-        }
-
-        for (int y = 1; y < item->height - 1; y++) {
-            wmove(win, item->pos + y, tui.term_width - 1);
-            waddwstr(win, config.borders.ls);
-        }
+        tui_tab_item_draw_borders(win, top, height);
     }
 
     wattroff(win, A_BOLD);
@@ -319,24 +441,31 @@ routes_end:
     #undef DRAW
 }
 
-static void tui_tab_item_draw_device(const struct tui_tab_item *const item,
+static void tui_tab_item_draw_device(struct tui_tab_item *const item,
                                      enum tui_tab_item_draw_mask mask) {
     #define DRAW(element) if (mask & TUI_TAB_ITEM_DRAW_##element)
 
-    const struct tui_tab_item_device_data *d = &item->as.device;
+    struct tui_tab_item_device_data *d = &item->as.device;
     const struct device *dev = item->as.device.dev;
 
-    const int usable_width = tui.term_width - 2; /* account for box borders */
+    const int usable_width = tui.geometry.usable_width;
 
     const bool focused = item->focused;
 
+    const int top = tui_tab_item_top(item);
+    const int height = tui_tab_item_height(item);
+
     TRACE("tui_draw_device: id %d mask %x", device_id(dev), mask);
 
-    WINDOW *const win = tui.pad_win;
+    WINDOW *const win = tui.tabs[item->tab_index].win;
 
     DRAW(BLANKS) {
-        for (int i = 0; i < item->height; i++) {
-            wmove(win, item->pos + i, 0);
+        for (int i = 0; i < height; i++) {
+            const int pos = view_row(top, i);
+            if (pos < 0) {
+                continue;
+            }
+            wmove(win, pos, 0);
             wclrtoeol(win);
         }
     }
@@ -346,82 +475,64 @@ static void tui_tab_item_draw_device(const struct tui_tab_item *const item,
     }
 
     DRAW(DESCRIPTION) {
-        int cols = print_with_ellipsis(win, item->pos + 1, 1,
-                                       d->info.data, d->info.len, usable_width);
-
-        for (int i = cols; i < usable_width; i++) {
-            waddch(win, ' ');
+        const int pos = view_row(top, 1);
+        if (pos < 0) {
+            goto description_end;
         }
+
+        int cols = tui_text_print(win, pos, 1, &d->info, usable_width);
+
+        fill_blanks(win, cols);
     }
+description_end:
 
     DRAW(PROFILES) {
         /* draw profiles */
-        const int profiles_line_pos = item->pos + item->height - 2;
+        const int profiles_line_pos = view_row(top, height - 2);
+        if (profiles_line_pos < 0) {
+            goto profiles_end;
+        }
 
         int cols = 0;
-        cols += print_with_ellipsis(win, profiles_line_pos, 1,
-                                    L"Profiles: ", wcslen(L"Profiles: "),
-                                    usable_width);
+        cols += tui_print_with_ellipsis(win, profiles_line_pos, 1,
+                                        L"Profiles: ", wcslen(L"Profiles: "),
+                                        usable_width);
 
         if (!d->n_profiles) {
             wattron(win, A_DIM);
-            cols += print_with_ellipsis(win, profiles_line_pos, 1 + cols,
-                                        L"(none)", wcslen(L"(none)"),
-                                        usable_width - cols);
+            cols += tui_print_with_ellipsis(win, profiles_line_pos, 1 + cols,
+                                            L"(none)", wcslen(L"(none)"),
+                                            usable_width - cols);
         } else {
             if (d->active_profile) {
                 /* draw active profile first */
-                cols += print_with_ellipsis(win, profiles_line_pos, 1 + cols,
-                                            d->active_profile->description.data,
-                                            d->active_profile->description.len,
-                                            usable_width - cols);
+                cols += tui_text_print(win, profiles_line_pos, 1 + cols,
+                                       &d->active_profile->description, usable_width - cols);
             }
 
             wattron(win, A_DIM);
             for (unsigned i = 0; i < d->n_profiles; i++) {
-                const struct profile_info *p = &d->profiles[i];
+                struct profile_info *p = &d->profiles[i];
                 if (p == d->active_profile) {
                     continue;
                 }
 
-                cols += print_with_ellipsis(win, profiles_line_pos, 1 + cols,
-                                            config.profiles_separator,
-                                            wcslen(config.profiles_separator),
-                                            usable_width - cols);
+                cols += tui_print_with_ellipsis(win, profiles_line_pos, 1 + cols,
+                                                config.profiles_separator,
+                                                wcslen(config.profiles_separator),
+                                                usable_width - cols);
 
-                cols += print_with_ellipsis(win, profiles_line_pos, 1 + cols,
-                                            p->description.data, p->description.len,
-                                            usable_width - cols);
+                cols += tui_text_print(win, profiles_line_pos, 1 + cols,
+                                       &p->description, usable_width - cols);
             }
         }
 
         wattroff(win, A_DIM);
     }
+profiles_end:
 
     DRAW(BORDERS) {
-        wmove(win, item->pos, 0);
-        waddwstr(win, config.borders.tl);
-        for (int x = 1; x < tui.term_width - 1; x++) {
-            waddwstr(win, config.borders.ts);
-        }
-        waddwstr(win, config.borders.tr);
-
-        wmove(win, item->pos + item->height - 1, 0);
-        waddwstr(win, config.borders.bl);
-        for (int x = 1; x < tui.term_width - 1; x++) {
-            waddwstr(win, config.borders.bs);
-        }
-        waddwstr(win, config.borders.br);
-
-        for (int y = 1; y < item->height - 1; y++) {
-            wmove(win, item->pos + y, 0);
-            waddwstr(win, config.borders.ls);
-        }
-
-        for (int y = 1; y < item->height - 1; y++) {
-            wmove(win, item->pos + y, tui.term_width - 1);
-            waddwstr(win, config.borders.ls);
-        }
+        tui_tab_item_draw_borders(win, top, height);
     }
 
     wattroff(win, A_BOLD);
@@ -429,9 +540,20 @@ static void tui_tab_item_draw_device(const struct tui_tab_item *const item,
     #undef DRAW
 }
 
-static void tui_tab_item_draw(const struct tui_tab_item *const item,
+static void tui_tab_item_draw(struct tui_tab_item *const item,
                               enum tui_tab_item_draw_mask mask) {
-    if (item->tab_index != tui.tab_index) {
+    struct tui_tab *const tab = &tui.tabs[item->tab_index];
+    if (tab->win == NULL) {
+        /* will be redrawn from scratch once it gets a pad again */
+        return;
+    } else if (tab->scroll_pos != tab->drawn_scroll_pos) {
+        /* view has scrolled since last full redraw, pad contents are stale anyway */
+        tab->redraw_pending = true;
+        return;
+    }
+
+    const int top = tui_tab_item_top(item);
+    if (top + tui_tab_item_height(item) <= 0 || top >= view_height()) {
         return;
     }
 
@@ -445,6 +567,78 @@ static void tui_tab_item_draw(const struct tui_tab_item *const item,
     }
 }
 
+/* Item will be drawn once in flush_tab(), no matter how many times this is called */
+static void tui_tab_item_queue_draw(struct tui_tab_item *const item,
+                                    enum tui_tab_item_draw_mask mask) {
+    struct tui_tab *const tab = &tui.tabs[item->tab_index];
+    if (tab->win == NULL) {
+        /* giving tab a pad again redraws everything anyway */
+        return;
+    }
+
+    if (item->dirty != TUI_TAB_ITEM_DRAW_NOTHING) {
+        tui.draws_saved += 1;
+    } else {
+        list_insert_before(&tab->dirty_items, &item->dirty_link);
+    }
+    item->dirty |= mask;
+}
+
+static void queue_redraw_tab(struct tui_tab *tab) {
+    tab->redraw_pending = true;
+}
+
+static void queue_redraw_current_tab(void) {
+    queue_redraw_tab(&tui.tabs[tui.tab_index]);
+}
+
+static void tui_tab_drop_queued_draws(struct tui_tab *tab) {
+    LIST_FOREACH(elem, &tab->dirty_items) {
+        struct tui_tab_item *item = CONTAINER_OF(elem, struct tui_tab_item, dirty_link);
+        item->dirty = TUI_TAB_ITEM_DRAW_NOTHING;
+        list_remove(&item->dirty_link);
+        tui.draws_saved += 1;
+    }
+}
+
+/* Makes sure tab has an up to date pad, taking one away from the tab that was shown
+ * least recently if TUI_MAX_CACHED_TABS tabs already have one. Marks tab as just shown */
+static void tui_tab_attach_pad(struct tui_tab *tab) {
+    tab->last_shown = ++tui.tab_clock;
+
+    if (tab->win != NULL) {
+        /* pad might have been drawn to while hidden, make sure all of it gets copied */
+        touchwin(tab->win);
+        return;
+    }
+
+    int cached = 0;
+    struct tui_tab *lru = NULL;
+    FOR_EACH_TAB(i) {
+        struct tui_tab *t = &tui.tabs[i];
+        if (t->win == NULL) {
+            continue;
+        }
+
+        cached += 1;
+        if (lru == NULL || t->last_shown < lru->last_shown) {
+            lru = t;
+        }
+    }
+
+    if (cached >= TUI_MAX_CACHED_TABS) {
+        DEBUG("evicting pad of tab %s", tui_tab_name(lru->type));
+        tui_tab_drop_queued_draws(lru);
+        tab->win = lru->win;
+        lru->win = NULL;
+    } else {
+        tab->win = newpad(view_height(), tui.term_width);
+    }
+
+    touchwin(tab->win);
+    queue_redraw_tab(tab);
+}
+
 /* this only updates scroll pos and does not actually draw anything */
 static void tui_tab_item_ensure_visible(const struct tui_tab_item *const item) {
     struct tui_tab *const tab = &tui.tabs[item->tab_index];
@@ -452,11 +646,14 @@ static void tui_tab_item_ensure_visible(const struct tui_tab_item *const item) {
     /* minus top bar */
     const int visible_height = tui.term_height - 1;
 
-    if (tab->scroll_pos > item->pos) {
-        tab->scroll_pos = item->pos;
-    } else if ((item->pos + item->height) > (tab->scroll_pos + visible_height)) {
+    const int pos = tui_tab_item_pos(item);
+    const int height = tui_tab_item_height(item);
+
+    if (tab->scroll_pos > pos) {
+        tab->scroll_pos = pos;
+    } else if ((pos + height) > (tab->scroll_pos + visible_height)) {
         /* a + b = c + d <=> c = a + b - d */
-        tab->scroll_pos = (item->pos + item->height) - visible_height;
+        tab->scroll_pos = (pos + height) - visible_height;
     }
 }
 
@@ -471,17 +668,17 @@ static void tui_tab_item_focus(struct tui_tab_item *const item, bool draw, bool
     } else if (tab->focused != NULL) {
         tab->focused->focused = false;
         if (draw) {
-            tui_tab_item_draw(tab->focused, TUI_TAB_ITEM_DRAW_EVERYTHING);
+            tui_tab_item_queue_draw(tab->focused, TUI_TAB_ITEM_DRAW_EVERYTHING);
         }
     }
 
     tab->focused = item;
     item->focused = true;
+    tui_tab_item_ensure_visible(item);
+
     if (draw) {
-        tui_tab_item_draw(item, TUI_TAB_ITEM_DRAW_EVERYTHING);
+        tui_tab_item_queue_draw(item, TUI_TAB_ITEM_DRAW_EVERYTHING);
     }
-
-    tui_tab_item_ensure_visible(item);
 }
 
 static void tui_tab_item_unfocus(struct tui_tab_item *const item, bool draw) {
@@ -527,7 +724,7 @@ void tui_bind_change_focus(union tui_bind_data data) {
                           && f->as.node.focused_channel < f->as.node.n_channels - 1;
         if (channel) {
             f->as.node.focused_channel += 1;
-            tui_tab_item_draw(f, TUI_TAB_ITEM_DRAW_DECORATIONS);
+            tui_tab_item_queue_draw(f, TUI_TAB_ITEM_DRAW_DECORATIONS);
         } else {
             struct tui_tab_item *next = NULL;
 
@@ -554,7 +751,7 @@ void tui_bind_change_focus(union tui_bind_data data) {
                           && f->as.node.focused_channel > 0;
         if (channel) {
             f->as.node.focused_channel -= 1;
-            tui_tab_item_draw(f, TUI_TAB_ITEM_DRAW_DECORATIONS);
+            tui_tab_item_queue_draw(f, TUI_TAB_ITEM_DRAW_DECORATIONS);
         } else {
             struct tui_tab_item *next = NULL;
 
@@ -578,31 +775,53 @@ void tui_bind_change_focus(union tui_bind_data data) {
     }
 }
 
-static void redraw_current_tab(void) {
-    const struct tui_tab *tab = &tui.tabs[tui.tab_index];
+/* Only items that intersect the visible area are drawn, pad is only as big as the screen */
+static void redraw_tab(struct tui_tab *tab) {
+    if (tab->win == NULL) {
+        return;
+    }
+
+    WINDOW *const win = tab->win;
+    const int height = view_height();
+
+    tab->drawn_scroll_pos = tab->scroll_pos;
+    tab->redraw_pending = false;
+
+    /* everything is about to be drawn anyway */
+    tui_tab_drop_queued_draws(tab);
 
+    /* find first visible item and walk the list from there */
     int bottom = 0;
-    LIST_FOREACH(elem, &tab->items) {
-        struct tui_tab_item *item = CONTAINER_OF(elem, struct tui_tab_item, link);
-        tui_tab_item_draw(item, TUI_TAB_ITEM_DRAW_EVERYTHING);
-        bottom += item->height;
+    struct sumtree_node *first = sumtree_find(&tab->layout, tab->scroll_pos);
+    if (first) {
+        struct tui_tab_item *item = CONTAINER_OF(first, struct tui_tab_item, layout);
+        bottom = tui_tab_item_top(item);
+
+        for (const struct list *elem = &item->link; elem != &tab->items; elem = elem->next) {
+            item = CONTAINER_OF(elem, struct tui_tab_item, link);
+            if (bottom >= height) {
+                break;
+            }
+
+            tui_tab_item_draw(item, TUI_TAB_ITEM_DRAW_EVERYTHING);
+            bottom += tui_tab_item_height(item);
+        }
     }
 
-    if (wmove(tui.pad_win, bottom, 0) != OK) {
-        WARN("wmove(tui.pad_win, %d, 0) failed!", bottom);
-    } else {
-        TRACE("wclrtobot(tui.pad_win) bottom %d", bottom);
-        wclrtobot(tui.pad_win);
+    if (bottom < height) {
+        TRACE("wclrtobot(tab->win) bottom %d", bottom);
+        wmove(win, bottom, 0);
+        wclrtobot(win);
     }
 
-    if (bottom == 0) {
+    if (list_is_empty(&tab->items)) {
         /* empty tab */
         static const char empty[] = "Empty";
-        wattron(tui.pad_win, A_DIM);
-        mvwaddstr(tui.pad_win,
+        wattron(win, A_DIM);
+        mvwaddstr(win,
                   (tui.term_height - 1) / 2, (tui.term_width / 2) - (strlen(empty) / 2),
                   empty);
-        wattroff(tui.pad_win, A_DIM);
+        wattroff(win, A_DIM);
     }
 }
 
@@ -736,7 +955,7 @@ void tui_bind_change_channel_lock(union tui_bind_data data) {
     }
 
     if (change) {
-        tui_tab_item_draw(focused, TUI_TAB_ITEM_DRAW_DECORATIONS);
+        tui_tab_item_queue_draw(focused, TUI_TAB_ITEM_DRAW_DECORATIONS);
     }
 }
 
@@ -748,8 +967,9 @@ static void tui_set_tab_and_redraw(int new_tab_index) {
         return;
     }
 
+    /* usually the pad is already up to date and switching is just copying it to the screen */
     tui.tab_index = new_tab_index;
-    redraw_current_tab();
+    tui_tab_attach_pad(&tui.tabs[tui.tab_index]);
     redraw_status_bar();
 
     TRACE("current tab is: index %d (%s)",
@@ -824,7 +1044,7 @@ static void on_profile_selection_done(struct tui_menu *menu, struct tui_menu_ite
     tui_menu_free(menu);
     tui.menu_active = false;
 
-    redraw_current_tab();
+    queue_redraw_current_tab();
 }
 
 void tui_bind_select_profile(union tui_bind_data data) {
@@ -846,14 +1066,14 @@ void tui_bind_select_profile(union tui_bind_data data) {
 
     tui_menu_resize(tui.menu, tui.term_width, tui.term_height);
 
-    wstring_printf(&tui.menu->header, L"Select profile for %ls", d->description.data);
+    wstring_printf(&tui.menu->header, L"Select profile for %s", string_data(&d->description));
 
     for (size_t i = 0; i < d->n_profiles; i++) {
         const struct profile_info *p = &d->profiles[i];
         struct tui_menu_item *item = &tui.menu->items[i];
 
-        wstring_printf(&item->wstr, L"%d. %ls (%ls)",
-                       p->index, p->description.data, p->name.data);
+        wstring_printf(&item->wstr, L"%d. %s (%s)",
+                       p->index, tui_text_data(&p->description), p->name);
         item->data.uint = p->index;
 
         if (p == d->active_profile) {
@@ -878,7 +1098,7 @@ static void on_route_selection_done(struct tui_menu *menu, struct tui_menu_item
     tui_menu_free(menu);
     tui.menu_active = false;
 
-    redraw_current_tab();
+    queue_redraw_current_tab();
 }
 
 void tui_bind_select_route(union tui_bind_data data) {
@@ -900,14 +1120,14 @@ void tui_bind_select_route(union tui_bind_data data) {
 
     tui_menu_resize(tui.menu, tui.term_width, tui.term_height);
 
-    wstring_printf(&tui.menu->header, L"Select route for %ls", d->description.data);
+    wstring_printf(&tui.menu->header, L"Select route for %s", string_data(&d->description));
 
     for (size_t i = 0; i < d->n_routes; i++) {
         const struct route_info *p = &d->routes[i];
         struct tui_menu_item *item = &tui.menu->items[i];
 
-        wstring_printf(&item->wstr, L"%d. %ls (%ls)",
-                       p->index, p->description.data, p->name.data);
+        wstring_printf(&item->wstr, L"%d. %s (%s)",
+                       p->index, tui_text_data(&p->description), p->name);
         item->data.uint = p->index;
 
         if (p == d->active_route) {
@@ -926,7 +1146,7 @@ void tui_bind_cancel_selection(union tui_bind_data data) {
     tui_menu_free(tui.menu);
     tui.menu_active = false;
 
-    redraw_current_tab();
+    queue_redraw_current_tab();
 }
 
 void tui_bind_confirm_selection(union tui_bind_data data) {
@@ -950,86 +1170,145 @@ void tui_bind_quit(union tui_bind_data data) {
     pw_main_loop_quit(main_loop);
 }
 
-/* Change size (height) of item to (new_height),
- * while also adjusting positions of other items in the same tab as needed.
+/* Change size (height) of item to (new_height).
+ * Positions of other items are derived from the tab layout tree, so they follow automatically.
  * DOES NOT DRAW ANYTHING BY ITSELF */
 static bool tui_tab_item_resize(struct tui_tab_item *item, int new_height) {
-    const int diff = new_height - item->height;
-    if (diff == 0) {
+    if (tui_tab_item_height(item) == new_height) {
         return false;
     }
 
-    const struct tui_tab *const tab = &tui.tabs[item->tab_index];
+    TRACE("tui_tab_item_resize: resizing item %p from %d to %d",
+          (void *)item, tui_tab_item_height(item), new_height);
+    sumtree_set_weight(&item->layout, new_height);
 
-    struct tui_tab_item *last = CONTAINER_OF(tab->items.prev, struct tui_tab_item, link);
-    tui.pad_win = tui_set_pad_size(tui.pad_win,
-                                   AT_LEAST, last->pos + last->height + diff,
-                                   AT_LEAST, tui.term_width);
+    return true;
+}
 
-    TRACE("tui_tab_item_resize: resizing item %p from %d to %d",
-          (void *)item, item->height, item->height + diff);
-    item->height += diff;
+/* Adds item to the beginning of its tab */
+static void tui_tab_item_insert(struct tui_tab_item *item) {
+    struct tui_tab *const tab = &tui.tabs[item->tab_index];
 
-    // iterate starting from the first element that should be moved
-    // TODO: make this a macro?
-    for (struct list *elem = item->link.next; elem != &tab->items; elem = elem->next) {
-        struct tui_tab_item *next = CONTAINER_OF(elem, struct tui_tab_item, link);
-        TRACE("tui_tab_item_resize: shifting item %p from %d to %d",
-              (void *)next, next->pos, next->pos + diff);
-        next->pos += diff;
-    }
+    list_init(&item->dirty_link);
+    list_insert_after(&tab->items, &item->link);
+    sumtree_insert_after(&tab->layout, NULL, &item->layout, 0);
 
-    return true;
+    tui.batch_changed_items = true;
 }
 
-static void on_device_profiles(struct device *dev,
-                               const struct param_profile *profiles, unsigned n_profiles,
-                               void *data) {
-    struct tui_tab_item *item = data;
+static void tui_tab_item_remove(struct tui_tab_item *item) {
+    struct tui_tab *const tab = &tui.tabs[item->tab_index];
+
+    list_remove(&item->dirty_link);
+    list_remove(&item->link);
+    sumtree_remove(&tab->layout, &item->layout);
+
+    tui.batch_changed_items = true;
+}
+
+/* returns false if profiles are the same as already applied */
+static bool apply_device_profiles(struct tui_tab_item *item,
+                                  const struct param_profiles *profiles) {
     struct tui_tab_item_device_data *d = &item->as.device;
 
+    if (profiles == d->profile_params) {
+        return false;
+    }
+
     for (unsigned i = 0; i < d->n_profiles; i++) {
         struct profile_info *oldp = &d->profiles[i];
-        wstring_free(&oldp->name);
-        wstring_free(&oldp->description);
+        tui_text_free(&oldp->description);
     }
 
-    d->n_profiles = n_profiles;
+    param_profiles_unref(&d->profile_params);
+    d->profile_params = param_profiles_ref(profiles);
+
+    d->n_profiles = profiles->count;
     d->profiles = xreallocarray(d->profiles, d->n_profiles, sizeof(d->profiles[0]));
     d->active_profile = NULL;
 
     for (unsigned i = 0; i < d->n_profiles; i++) {
         struct profile_info *pi = &d->profiles[i];
-        const struct param_profile *pp = &profiles[i];
+        const struct param_profile *pp = &profiles->items[i];
 
-        wstring_init(&pi->name);
-        wstring_init(&pi->description);
+        tui_text_init(&pi->description);
 
         pi->index = pp->index;
+        pi->name = pp->name;
 
-        wstring_printf(&pi->name, L"%s", pp->name);
-        wstring_printf(&pi->description, L"%s", pp->description);
+        tui_text_borrow(&pi->description, pp->description);
 
         if (pp->active) {
             d->active_profile = pi;
         }
     }
 
-    tui_tab_item_draw(item, TUI_TAB_ITEM_DRAW_PROFILES);
+    return true;
+}
+
+/* returns false if nothing that is displayed has changed */
+static bool apply_device_props(struct tui_tab_item *item, const struct dict *props,
+                               const struct dict_changes *changed) {
+    struct tui_tab_item_device_data *d = &item->as.device;
+    bool applied = false;
+
+    /* both checks are cheap: the first one skips updates that don't touch any key of the
+     * format, the second one those that set them to the same values as before.
+     * The first props event only lists keys that are present, so until something is
+     * rendered the first check is skipped, or formats with no keys present never render */
+    if ((!d->info_args.filled || format_depends_on(config.device_format, changed))
+        && format_args_update(config.device_format, &d->info_args, props)) {
+        tui_text_clear(&d->info);
+        format_render(config.device_format, &d->info_args, &d->info.str);
+        tui_text_changed(&d->info);
+        applied = true;
+    }
+
+    if (dict_changes_has(changed, "device.description")) {
+        string_clear(&d->description);
+        string_printf(&d->description, "%s", dict_get(props, "device.description"));
+        applied = true;
+    }
+
+    return applied;
+}
+
+static void on_device_profiles(struct device *dev, const struct param_profiles *profiles,
+                               void *data) {
+    struct tui_tab_item *item = data;
+
+    if (!apply_device_profiles(item, profiles)) {
+        return;
+    }
+
+    tui_tab_item_queue_draw(item, TUI_TAB_ITEM_DRAW_PROFILES);
     trigger_update();
 }
 
-static void on_device_props(struct device *dev, const struct dict *props, void *data) {
+static void on_device_props(struct device *dev, const struct dict *props,
+                            const struct dict_changes *changed, void *data) {
     struct tui_tab_item *item = data;
-    struct tui_tab_item_device_data *d = &item->as.device;
 
-    wstring_clear(&d->info);
-    format_render(config.device_format, props, &d->info);
+    if (!apply_device_props(item, props, changed)) {
+        return;
+    }
+
+    tui_tab_item_queue_draw(item, TUI_TAB_ITEM_DRAW_DESCRIPTION);
+    trigger_update();
+}
 
-    wstring_clear(&d->description);
-    wstring_printf(&d->description, L"%s", dict_get(props, "device.description"));
+static void on_device_snapshot(struct device *dev, const struct device_snapshot *snapshot,
+                               void *data) {
+    struct tui_tab_item *item = data;
+
+    if (snapshot->has_props) {
+        apply_device_props(item, snapshot->props, NULL);
+    }
+    if (snapshot->has_profiles) {
+        apply_device_profiles(item, snapshot->profiles);
+    }
 
-    tui_tab_item_draw(item, TUI_TAB_ITEM_DRAW_DESCRIPTION);
+    tui_tab_item_queue_draw(item, TUI_TAB_ITEM_DRAW_EVERYTHING);
     trigger_update();
 }
 
@@ -1045,37 +1324,41 @@ static void on_device_removed(struct device *dev, void *data) {
     tui_tab_item_resize(item, 0);
     tui_tab_item_unfocus(item, false);
 
-    list_remove(&item->link);
+    tui_tab_item_remove(item);
 
-    if (item->tab_index == tui.tab_index) {
-        redraw_current_tab();
-        trigger_update();
-    }
+    queue_redraw_tab(&tui.tabs[item->tab_index]);
+    trigger_update();
 
-    wstring_free(&d->description);
-    wstring_free(&d->info);
+    string_free(&d->description);
+    tui_text_free(&d->info);
+    format_args_free(&d->info_args);
     for (unsigned i = 0; i < d->n_profiles; i++) {
-        wstring_free(&d->profiles[i].name);
-        wstring_free(&d->profiles[i].description);
+        tui_text_free(&d->profiles[i].description);
     }
     free(d->profiles);
+    param_profiles_unref(&d->profile_params);
 
     free(item);
 }
 
 static const struct device_events device_events = {
+    .snapshot = on_device_snapshot,
     .props = on_device_props,
     .profiles = on_device_profiles,
     .removed = on_device_removed,
 };
 
+static int node_item_height(const struct tui_tab_item_node_data *d) {
+    return d->n_channels + 3 + (bool)d->n_routes;
+}
+
 static void on_node_default(struct node *node, bool is_default, void *data) {
     struct tui_tab_item *item = data;
     struct tui_tab_item_node_data *d = &item->as.node;
 
     d->is_default = is_default;
 
-    tui_tab_item_draw(item, TUI_TAB_ITEM_DRAW_DESCRIPTION);
+    tui_tab_item_queue_draw(item, TUI_TAB_ITEM_DRAW_DESCRIPTION);
     trigger_update();
 }
 
@@ -1085,75 +1368,87 @@ static void on_node_mute(struct node *node, bool muted, void *data) {
 
     d->muted = muted;
 
-    tui_tab_item_draw(item, TUI_TAB_ITEM_DRAW_CHANNELS | TUI_TAB_ITEM_DRAW_DECORATIONS);
+    tui_tab_item_queue_draw(item, TUI_TAB_ITEM_DRAW_CHANNELS | TUI_TAB_ITEM_DRAW_DECORATIONS);
     trigger_update();
 }
 
-static void on_node_routes(struct node *node,
-                           const struct param_route routes[], unsigned routes_count,
-                           void *data) {
-    struct tui_tab_item *item = data;
+/* returns false if routes are the same as already applied */
+static bool apply_node_routes(struct tui_tab_item *item, const struct param_routes *routes) {
     struct tui_tab_item_node_data *d = &item->as.node;
 
+    if (routes == d->route_params) {
+        return false;
+    }
+
     for (unsigned i = 0; i < d->n_routes; i++) {
         struct route_info *oldp = &d->routes[i];
-        wstring_free(&oldp->name);
-        wstring_free(&oldp->description);
+        tui_text_free(&oldp->description);
     }
 
-    const unsigned old_n_routes = d->n_routes;
+    param_routes_unref(&d->route_params);
+    d->route_params = param_routes_ref(routes);
 
-    d->n_routes = routes_count;
+    d->n_routes = routes->count;
     d->routes = xreallocarray(d->routes, d->n_routes, sizeof(d->routes[0]));
     d->active_route = NULL;
 
     for (unsigned i = 0; i < d->n_routes; i++) {
         struct route_info *pi = &d->routes[i];
-        const struct param_route *pp = &routes[i];
+        const struct param_route *pp = &routes->items[i];
 
-        wstring_init(&pi->name);
-        wstring_init(&pi->description);
+        tui_text_init(&pi->description);
 
         pi->index = pp->index;
+        pi->name = pp->name;
 
-        wstring_printf(&pi->name, L"%s", pp->name);
-        wstring_printf(&pi->description, L"%s", pp->description);
+        tui_text_borrow(&pi->description, pp->description);
 
         if (pp->active) {
             d->active_route = pi;
         }
     }
 
-    if ((old_n_routes && !d->n_routes) || (!old_n_routes && d->n_routes)) {
-        tui_tab_item_resize(item, d->n_channels + 3 + (bool)d->n_routes);
-        if (item->tab_index == tui.tab_index) {
-            redraw_current_tab();
-        }
+    return true;
+}
+
+static void on_node_routes(struct node *node, const struct param_routes *routes, void *data) {
+    struct tui_tab_item *item = data;
+
+    if (!apply_node_routes(item, routes)) {
+        return;
+    }
+
+    if (tui_tab_item_resize(item, node_item_height(&item->as.node))) {
+        queue_redraw_tab(&tui.tabs[item->tab_index]);
     } else {
-        tui_tab_item_draw(item, TUI_TAB_ITEM_DRAW_ROUTES);
+        tui_tab_item_queue_draw(item, TUI_TAB_ITEM_DRAW_ROUTES);
     }
 
     trigger_update();
 }
 
-static void on_node_volume(struct node *node,
-                           const float channel_volumes[], unsigned channel_count,
-                           void *data) {
-    struct tui_tab_item *item = data;
+static void apply_node_volume(struct tui_tab_item *item,
+                              const float channel_volumes[], unsigned channel_count) {
     struct tui_tab_item_node_data *d = &item->as.node;
 
     for (unsigned i = 0; i < channel_count; i++) {
         d->channels[i].volume = channel_volumes[i];
     }
+}
+
+static void on_node_volume(struct node *node,
+                           const float channel_volumes[], unsigned channel_count,
+                           void *data) {
+    struct tui_tab_item *item = data;
 
-    tui_tab_item_draw(item, TUI_TAB_ITEM_DRAW_CHANNELS);
+    apply_node_volume(item, channel_volumes, channel_count);
+
+    tui_tab_item_queue_draw(item, TUI_TAB_ITEM_DRAW_CHANNELS);
     trigger_update();
 }
 
-static void on_node_channels(struct node *node,
-                             const char *channel_names[], unsigned channel_count,
-                             void *data) {
-    struct tui_tab_item *item = data;
+static void apply_node_channels(struct tui_tab_item *item,
+                                const char *const channel_names[], unsigned channel_count) {
     struct tui_tab_item_node_data *d = &item->as.node;
 
     d->n_channels = channel_count;
@@ -1165,29 +1460,88 @@ static void on_node_channels(struct node *node,
     for (unsigned i = 0; i < channel_count; i++) {
         d->channels[i].name = channel_names[i];
     }
+}
+
+static void on_node_channels(struct node *node,
+                             const char *channel_names[], unsigned channel_count,
+                             void *data) {
+    struct tui_tab_item *item = data;
 
-    tui_tab_item_resize(item, d->n_channels + 3 + (bool)d->n_routes);
+    apply_node_channels(item, channel_names, channel_count);
 
-    if (item->tab_index == tui.tab_index) {
-        redraw_current_tab();
-    }
+    tui_tab_item_resize(item, node_item_height(&item->as.node));
+
+    queue_redraw_tab(&tui.tabs[item->tab_index]);
     trigger_update();
 }
 
-static void on_node_props(struct node *node, const struct dict *props, void *data) {
-    struct tui_tab_item *item = data;
+/* returns false if nothing that is displayed has changed */
+static bool apply_node_props(struct tui_tab_item *item, const struct dict *props,
+                             const struct dict_changes *changed) {
     struct tui_tab_item_node_data *d = &item->as.node;
+    bool applied = false;
+
+    /* see apply_device_props() */
+    if ((!d->info_args.filled || format_depends_on(config.node_format, changed))
+        && format_args_update(config.node_format, &d->info_args, props)) {
+        tui_text_clear(&d->info);
+        format_render(config.node_format, &d->info_args, &d->info.str);
+        tui_text_changed(&d->info);
+        applied = true;
+    }
 
-    wstring_clear(&d->info);
-    format_render(config.node_format, props, &d->info);
+    if (dict_changes_has(changed, "node.description") || dict_changes_has(changed, "node.name")) {
+        const char *node_description = dict_get(props, "node.description");
+        const char *node_name = dict_get(props, "node.name");
 
-    const char *node_description = dict_get(props, "node.description");
-    const char *node_name = dict_get(props, "node.name");
+        string_clear(&d->description);
+        string_printf(&d->description, "%s", node_description ?: node_name);
+        applied = true;
+    }
 
-    wstring_clear(&d->description);
-    wstring_printf(&d->description, L"%s", node_description ?: node_name);
+    return applied;
+}
+
+static void on_node_props(struct node *node, const struct dict *props,
+                          const struct dict_changes *changed, void *data) {
+    struct tui_tab_item *item = data;
 
-    tui_tab_item_draw(item, TUI_TAB_ITEM_DRAW_DESCRIPTION);
+    if (!apply_node_props(item, props, changed)) {
+        return;
+    }
+
+    tui_tab_item_queue_draw(item, TUI_TAB_ITEM_DRAW_DESCRIPTION);
+    trigger_update();
+}
+
+/* Initial state of a new item, applied all at once so it's laid out and drawn only once */
+static void on_node_snapshot(struct node *node, const struct node_snapshot *snapshot,
+                             void *data) {
+    struct tui_tab_item *item = data;
+    struct tui_tab_item_node_data *d = &item->as.node;
+
+    if (snapshot->has_props) {
+        apply_node_props(item, snapshot->props, NULL);
+    }
+    if (snapshot->has_routes) {
+        apply_node_routes(item, snapshot->routes);
+    }
+    if (snapshot->has_param_props) {
+        apply_node_channels(item, snapshot->channel_names, snapshot->channel_count);
+        apply_node_volume(item, snapshot->channel_volumes, snapshot->channel_count);
+        d->muted = snapshot->mute;
+    }
+    if (snapshot->has_default) {
+        d->is_default = snapshot->is_default;
+    }
+
+    /* like separate events would, item stays hidden until it has channels or routes */
+    const bool sized = snapshot->has_param_props || d->n_routes;
+    if (sized && tui_tab_item_resize(item, node_item_height(d))) {
+        queue_redraw_tab(&tui.tabs[item->tab_index]);
+    } else {
+        tui_tab_item_queue_draw(item, TUI_TAB_ITEM_DRAW_EVERYTHING);
+    }
     trigger_update();
 }
 
@@ -1203,26 +1557,26 @@ static void on_node_removed(struct node *node, void *data) {
     tui_tab_item_resize(item, 0);
     tui_tab_item_unfocus(item, false);
 
-    list_remove(&item->link);
+    tui_tab_item_remove(item);
 
-    if (item->tab_index == tui.tab_index) {
-        redraw_current_tab();
-        trigger_update();
-    }
+    queue_redraw_tab(&tui.tabs[item->tab_index]);
+    trigger_update();
 
-    wstring_free(&d->description);
-    wstring_free(&d->info);
+    string_free(&d->description);
+    tui_text_free(&d->info);
+    format_args_free(&d->info_args);
     for (unsigned i = 0; i < d->n_routes; i++) {
-        wstring_free(&d->routes[i].name);
-        wstring_free(&d->routes[i].description);
+        tui_text_free(&d->routes[i].description);
     }
     free(d->routes);
+    param_routes_unref(&d->route_params);
     free(d->channels);
 
     free(item);
 }
 
 static const struct node_events node_events = {
+    .snapshot = on_node_snapshot,
     .removed = on_node_removed,
     .props = on_node_props,
     .channels = on_node_channels,
@@ -1253,14 +1607,14 @@ static void on_pipewire_device(struct device *dev, void *_) {
     new_item->hook = device_add_listener(dev, &device_events, new_item);
 
     const int new_item_height = 4;
-    list_insert_after(&tui.tabs[tab_index].items, &new_item->link);
+    tui_tab_item_insert(new_item);
     tui_tab_item_resize(new_item, new_item_height);
 
     if (tui.tabs[tab_index].focused == NULL || !tui.tabs[tab_index].user_changed_focus) {
         tui_tab_item_focus(new_item, false, false);
     }
 
-    redraw_current_tab();
+    queue_redraw_tab(&tui.tabs[tab_index]);
     trigger_update();
 }
 
@@ -1285,20 +1639,44 @@ static void on_pipewire_node(struct node *node, void *_) {
     new_item->hook = node_add_listener(node, &node_events, new_item);
 
     int new_item_height = new_item->as.node.n_channels + 3;
-    list_insert_after(&tui.tabs[tab_index].items, &new_item->link);
+    tui_tab_item_insert(new_item);
     tui_tab_item_resize(new_item, new_item_height);
 
     if (tui.tabs[tab_index].focused == NULL || !tui.tabs[tab_index].user_changed_focus) {
         tui_tab_item_focus(new_item, false, false);
     }
 
-    redraw_current_tab();
+    queue_redraw_tab(&tui.tabs[tab_index]);
     trigger_update();
 }
 
+static void on_pipewire_batch(bool active, void *_) {
+    TRACE("on_pipewire_batch: active %d", active);
+
+    tui.batching = active;
+    if (active) {
+        tui.batch_changed_items = false;
+        if (!tui.batch_start) {
+            tui.batch_start = monotonic_time_ns();
+        }
+    } else if (tui.batch_changed_items) {
+        /* lay out and paint everything once */
+        queue_redraw_current_tab();
+        trigger_update();
+    } else {
+        /* nothing was added or removed, only catch up on frames skipped while waiting.
+         * Startup is timed until its first frame even if there were no items */
+        if (tui.first_frame_drawn) {
+            tui.batch_start = 0;
+        }
+        trigger_update();
+    }
+}
+
 static const struct pipewire_events pipewire_events = {
     .node = on_pipewire_node,
     .device = on_pipewire_device,
+    .batch = on_pipewire_batch,
 };
 
 static void on_stdin_ready(void *_, int _, uint32_t _) {
@@ -1332,19 +1710,29 @@ static void on_resize_triggered(void *_, uint64_t _) {
     tui.term_width = getmaxx(stdscr);
     DEBUG("new window dimensions %d lines %d columns", tui.term_height, tui.term_width);
 
-    tui.pad_win = tui_set_pad_size(tui.pad_win,
-                                   AT_LEAST, tui.term_height,
-                                   EXACTLY, tui.term_width);
-    if (tui.tabs[tui.tab_index].focused != NULL) {
-        tui_tab_item_ensure_visible(tui.tabs[tui.tab_index].focused);
+    /* pads only hold what fits on the screen, minus top bar */
+    FOR_EACH_TAB(i) {
+        struct tui_tab *tab = &tui.tabs[i];
+        if (tab->win != NULL) {
+            tab->win = tui_set_pad_size(tab->win,
+                                        EXACTLY, view_height(),
+                                        EXACTLY, tui.term_width);
+            queue_redraw_tab(tab);
+        }
+        if (tab->focused != NULL) {
+            tui_tab_item_ensure_visible(tab->focused);
+        }
     }
+    tui_tab_attach_pad(&tui.tabs[tui.tab_index]);
 
     if (tui.bar_win != NULL) {
         delwin(tui.bar_win);
     }
     tui.bar_win = newwin(1, tui.term_width, 0, 0);
 
-    redraw_current_tab();
+    update_geometry();
+
+    redraw_tab(&tui.tabs[tui.tab_index]);
     redraw_status_bar();
 
     if (tui.menu_active) {
@@ -1352,6 +1740,55 @@ static void on_resize_triggered(void *_, uint64_t _) {
     }
 }
 
+static bool tui_tab_is_stale(const struct tui_tab *tab) {
+    return tab->win != NULL
+        && (tab->redraw_pending || tab->scroll_pos != tab->drawn_scroll_pos
+            || !list_is_empty(&tab->dirty_items));
+}
+
+/* draws every item of tab that was queued with tui_tab_item_queue_draw() exactly once */
+static void flush_tab(struct tui_tab *tab) {
+    if (tab->win == NULL) {
+        return;
+    }
+
+    if (tab->redraw_pending || tab->scroll_pos != tab->drawn_scroll_pos) {
+        redraw_tab(tab);
+    }
+
+    LIST_FOREACH(elem, &tab->dirty_items) {
+        struct tui_tab_item *item = CONTAINER_OF(elem, struct tui_tab_item, dirty_link);
+        tui_tab_item_draw(item, item->dirty);
+        item->dirty = TUI_TAB_ITEM_DRAW_NOTHING;
+        list_remove(&item->dirty_link);
+    }
+}
+
+/* Brings at most one hidden tab pad up to date per frame, so that switching to it later
+ * is just a copy. Returns true if there are more hidden tabs left to catch up */
+static bool flush_background_tab(void) {
+    bool flushed = false;
+
+    for (int n = 1; n < tui.tabs_count; n++) {
+        const int i = (tui.background_tab_index + n) % tui.tabs_count;
+        struct tui_tab *tab = &tui.tabs[i];
+        if (i == tui.tab_index || !tui_tab_is_stale(tab)) {
+            continue;
+        }
+
+        if (flushed) {
+            return true;
+        }
+
+        TRACE("catching up background tab %s", tui_tab_name(tab->type));
+        flush_tab(tab);
+        tui.background_tab_index = i;
+        flushed = true;
+    }
+
+    return false;
+}
+
 /*
  * Trying to optimize updates is brain damage and I don't wanna deal with it.
  * Instead just update after any event that might or might not cause a draw
@@ -1360,8 +1797,19 @@ static void on_resize_triggered(void *_, uint64_t _) {
 static void on_update_triggered(void *_, uint64_t _) {
     tui.update_triggered = false;
 
-    pnoutrefresh(tui.pad_win,
-                 tui.tabs[tui.tab_index].scroll_pos, 0,
+    if (tui.batching) {
+        /* graph is still changing, everything will be redrawn when it settles */
+        return;
+    }
+
+    tui.last_frame = monotonic_time_ns();
+
+    struct tui_tab *const tab = &tui.tabs[tui.tab_index];
+    flush_tab(tab);
+    const bool more_background_work = flush_background_tab();
+
+    pnoutrefresh(tab->win,
+                 0, 0,
                  1, 0,
                  tui.term_height - 1, tui.term_width - 1);
 
@@ -1372,6 +1820,21 @@ static void on_update_triggered(void *_, uint64_t _) {
     }
 
     doupdate();
+
+    if (tui.batch_start) {
+        const double ms = (double)(monotonic_time_ns() - tui.batch_start) / 1000000;
+        if (!tui.first_frame_drawn) {
+            INFO("time to first frame after startup: %.2f ms", ms);
+        } else {
+            DEBUG("time to first frame after graph changes: %.2f ms", ms);
+        }
+        tui.batch_start = 0;
+    }
+    tui.first_frame_drawn = true;
+
+    if (more_background_work) {
+        trigger_update();
+    }
 }
 
 static void on_sigwinch(int _) {
@@ -1379,7 +1842,30 @@ static void on_sigwinch(int _) {
     trigger_update();
 }
 
+/* Tells nodes and devices which props keys are displayed, others are not even stored */
+static void keep_props_keys(void) {
+    struct dict_keys keys = {0};
+
+    format_collect_keys(config.node_format, &keys);
+    dict_keys_add(&keys, "node.description");
+    dict_keys_add(&keys, "node.name");
+    node_keep_props_keys(&keys);
+
+    dict_keys_clear(&keys);
+
+    format_collect_keys(config.device_format, &keys);
+    dict_keys_add(&keys, "device.description");
+    device_keep_props_keys(&keys);
+
+    dict_keys_free(&keys);
+}
+
 bool tui_init(void) {
+    keep_props_keys();
+
+    /* startup counts as a batch for the purposes of time-to-first-frame */
+    tui.batch_start = monotonic_time_ns();
+
     /* must set signal handler BEFORE ncurses init */
     sigaction(SIGWINCH, &(struct sigaction){
         .sa_handler = on_sigwinch,
@@ -1408,6 +1894,7 @@ bool tui_init(void) {
 
         tab->type = config.tabs[i];
         list_init(&tab->items);
+        list_init(&tab->dirty_items);
 
         if (tab->type == config.default_tab) {
             tui.tab_index = i;
@@ -1420,6 +1907,7 @@ bool tui_init(void) {
     tui.resize_triggered = false;
 
     tui.update_source = pw_loop_add_event(event_loop, on_update_triggered, event_loop);
+    tui.update_timer = pw_loop_add_timer(event_loop, on_update_triggered, event_loop);
     tui.update_triggered = false;
 
     tui.pipewire_hook = pipewire_add_listener(&pipewire_events, &tui);
@@ -1431,12 +1919,20 @@ bool tui_init(void) {
 }
 
 void tui_cleanup(void) {
+    DEBUG("tui: %"PRIu64" item draws saved by batching", tui.draws_saved);
+
     if (tui.bar_win != NULL) {
         delwin(tui.bar_win);
     }
-    if (tui.pad_win != NULL) {
-        delwin(tui.pad_win);
+    FOR_EACH_TAB(i) {
+        if (tui.tabs[i].win != NULL) {
+            delwin(tui.tabs[i].win);
+        }
     }
+    free(tui.bar_cells);
+    wstring_free(&tui.geometry.border_top);
+    wstring_free(&tui.geometry.border_bottom);
+    wstring_free(&tui.geometry.blanks);
 
     endwin();
 }
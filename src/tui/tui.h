@@ -3,8 +3,12 @@
 #include <ncurses.h>
 
 #include "tui/menu.h"
+#include "tui/text.h"
 #include "collections/list.h"
+#include "collections/sumtree.h"
+#include "collections/string.h"
 #include "collections/wstring.h"
+#include "format.h"
 #include "events.h"
 
 enum tui_tab_type {
@@ -20,26 +24,71 @@ enum tui_tab_type {
 struct tui_tab {
     enum tui_tab_type type;
     struct list items;
+    /* same items in the same order, weighted by height */
+    struct sumtree layout;
     struct tui_tab_item *focused;
     int scroll_pos;
     bool user_changed_focus;
+
+    /* holds only the visible part of the tab, NULL if evicted, see tui_tab_attach_pad() */
+    WINDOW *win;
+    /* scroll_pos at the time win was last fully redrawn */
+    int drawn_scroll_pos;
+    bool redraw_pending;
+    /* items waiting to be drawn into win, linked by dirty_link */
+    struct list dirty_items;
+    /* value of tui.tab_clock when tab was last shown, for LRU eviction of win */
+    uint64_t last_shown;
 };
 
 struct tui {
     int term_height, term_width;
 
     WINDOW *bar_win;
-    WINDOW *pad_win;
+
+    /* geometry of items, only depends on term_width and config, see update_geometry() */
+    struct tui_geometry {
+        int usable_width;
+        int info_area_start;
+        int volume_area_start;
+        int volume_bar_start, volume_bar_width;
+        /* whole top and bottom border lines */
+        struct wstring border_top, border_bottom;
+        /* usable_width spaces */
+        struct wstring blanks;
+    } geometry;
+
+    /* prebuilt volume bar cells, see bar_cells() */
+    cchar_t *bar_cells;
+    int bar_cells_width;
+
+    /* how many draws were merged into an already queued one */
+    uint64_t draws_saved;
 
     bool menu_active;
     struct tui_menu *menu;
 
     int tabs_count, tab_index;
     struct tui_tab *tabs;
+    uint64_t tab_clock;
+    /* last background tab that was given a chance to catch up */
+    int background_tab_index;
 
     struct spa_source *stdin_source;
     bool update_triggered;
     struct spa_source *update_source;
+    /* used instead of update_source when frame rate is capped, see config.max_fps */
+    struct spa_source *update_timer;
+    uint64_t last_frame;
+
+    /* see pipewire_events.batch */
+    bool batching;
+    /* items were added or removed since the batch started */
+    bool batch_changed_items;
+    uint64_t batch_start;
+    /* time to first frame of startup is logged at INFO, later ones at DEBUG */
+    bool first_frame_drawn;
+
     bool resize_triggered;
     struct spa_source *resize_source;
 
@@ -65,9 +114,14 @@ enum tui_tab_item_type {
 };
 
 struct tui_tab_item {
-    int pos, height;
+    /* position and height in the tab, see tui_tab_item_pos() and tui_tab_item_height() */
+    struct sumtree_node layout;
     bool focused;
 
+    /* parts that need to be drawn on next update */
+    enum tui_tab_item_draw_mask dirty;
+    struct list dirty_link;
+
     enum tui_tab_item_type type;
     union {
         struct tui_tab_item_node_data {
@@ -76,7 +130,10 @@ struct tui_tab_item {
 
             bool is_default;
 
-            struct wstring info, description;
+            struct tui_text info;
+            /* values of keys referenced by node-format or device-format */
+            struct format_args info_args;
+            struct string description;
 
             bool muted;
 
@@ -86,12 +143,19 @@ struct tui_tab_item {
             struct channel_info {
                 const char *name;
                 float volume;
+                /* number of filled volume bar cells currently on screen */
+                int drawn_fill;
             } *channels;
+            /* see bar_cells(), volume bars are only redrawn partially if this didn't change */
+            unsigned drawn_bar_variant;
 
+            /* shared with the node, route names and descriptions point into it */
+            struct param_routes *route_params;
             unsigned n_routes;
             struct route_info {
                 int32_t index;
-                struct wstring name, description;
+                const char *name;
+                struct tui_text description;
             } *routes;
             struct route_info *active_route;
         } node;
@@ -99,12 +163,18 @@ struct tui_tab_item {
             uint32_t id;
             struct device *dev;
 
-            struct wstring info, description;
+            struct tui_text info;
+            /* values of keys referenced by node-format or device-format */
+            struct format_args info_args;
+            struct string description;
 
+            /* shared with the device, profile names and descriptions point into it */
+            struct param_profiles *profile_params;
             unsigned n_profiles;
             struct profile_info {
                 int32_t index;
-                struct wstring name, description;
+                const char *name;
+                struct tui_text description;
             } *profiles;
             struct profile_info *active_profile;
         } device;
@@ -1,6 +1,7 @@
 #include <ctype.h>
 #include <stdlib.h>
 #include <limits.h>
+#include <time.h>
 
 #include <ncurses.h>
 #include <spa/utils/string.h>
@@ -100,3 +101,18 @@ bool cut_prefix(const char *str, const char *prefix, const char **suffix) {
     return true;
 }
 
+uint64_t monotonic_time_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+uint32_t str_hash(const char *str) {
+    uint32_t hash = 2166136261u;
+    for (const unsigned char *p = (const unsigned char *)str; *p != '\0'; p++) {
+        hash ^= *p;
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
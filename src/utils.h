@@ -1,6 +1,7 @@
 #pragma once
 
 #include <stdbool.h>
+#include <stdint.h>
 #include <wchar.h>
 
 const char *key_name_from_key_code(wint_t code);
@@ -13,3 +14,9 @@ bool strneq(const char *a, const char *b, size_t len);
 /* returns true if str begins with prefix and puts the rest in suffix */
 bool cut_prefix(const char *str, const char *prefix, const char **suffix);
 
+/* CLOCK_MONOTONIC in nanoseconds */
+uint64_t monotonic_time_ns(void);
+
+/* FNV-1a */
+uint32_t str_hash(const char *str);
+